@@ -0,0 +1,56 @@
+#ifndef __INSOTU_ADAPTIVESAMPLING_H
+#define __INSOTU_ADAPTIVESAMPLING_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace insotu {
+
+/**
+ * Adaptive polling interval for threshold monitors
+ *
+ * The interval shrinks linearly from maxInterval to minInterval as the
+ * monitored metric approaches the threshold it would cross next. Distance
+ * is measured relative to the hysteresis span of the monitor (e.g. high -
+ * low watermark), so a metric one span or more away is polled at
+ * maxInterval and one sitting on the threshold at minInterval.
+ */
+class AdaptiveSampling
+{
+  protected:
+    bool enabled = false;
+    double minInterval = 0;             // seconds
+    double maxInterval = 0;             // seconds
+    double distance = 1;                // smallest relative distance noted since reset()
+
+  public:
+    void configure(bool enabled, double minInterval, double maxInterval)
+    {
+        this->enabled = enabled;
+        this->minInterval = minInterval;
+        this->maxInterval = maxInterval;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    void reset() { distance = 1; }
+
+    // Records how far value is from the threshold it would cross next
+    void note(double value, double threshold, double span)
+    {
+        double d = span > 0 ? std::fabs(value - threshold) / span : 0;
+        distance = std::min(distance, d);
+    }
+
+    // Interval until the next poll; fixedInterval when adaptive sampling is off
+    double nextInterval(double fixedInterval) const
+    {
+        if (!enabled)
+            return fixedInterval;
+        return minInterval + (maxInterval - minInterval) * std::min(1.0, distance);
+    }
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,191 @@
+#include "ClassQueueMonitor.h"
+
+#include "RsvpTeScriptable.h"
+#include "inet/common/Simsignals.h"
+#include "inet/common/packet/Packet.h"
+#include "inet/queueing/contract/IPacketQueue.h"
+#include <omnetpp.h>
+
+namespace insotu {
+
+using namespace omnetpp;
+using inet::queueing::IPacketQueue;
+
+Define_Module(ClassQueueMonitor);
+
+void ClassQueueMonitor::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled");
+        if (!enabled)
+            return;
+
+        interval = par("checkInterval");
+
+        const char *rsvpPath = par("rsvpModule");
+        cModule *rsvpModule = rsvpPath && *rsvpPath ? getModuleByPath(rsvpPath) : nullptr;
+        rsvp = rsvpModule ? dynamic_cast<insotu::RsvpTeScriptable *>(rsvpModule) : nullptr;
+        if (!rsvp)
+            throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
+
+        readClasses(par("classes").xmlValue());
+
+        timer = new cMessage("poll");
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (enabled && timer) {
+            for (auto& trafficClass : classes)
+                trafficClass.queueModule->subscribe(inet::packetDroppedSignal, this);
+            scheduleAt(simTime() + interval, timer);
+        }
+    }
+}
+
+void ClassQueueMonitor::readClasses(const cXMLElement *config)
+{
+    if (!config)
+        throw cRuntimeError("ClassQueueMonitor requires a classes configuration");
+
+    for (cXMLElement *classElem : config->getChildrenByTagName("class")) {
+        const char *name = classElem->getAttribute("name");
+        const char *queuePath = classElem->getAttribute("queue");
+        if (!name || !queuePath)
+            throw cRuntimeError("Class entry requires 'name' and 'queue' attributes at %s", classElem->getSourceLocation());
+
+        classes.emplace_back();
+        TrafficClass& trafficClass = classes.back();
+        trafficClass.name = name;
+
+        trafficClass.queueModule = getModuleByPath(queuePath);
+        trafficClass.queue = dynamic_cast<IPacketQueue *>(trafficClass.queueModule);
+        if (!trafficClass.queue)
+            throw cRuntimeError("Queue module '%s' of class %s is not an IPacketQueue", queuePath, name);
+
+        if (const char *tunnels = classElem->getAttribute("tunnels")) {
+            cStringTokenizer tokenizer(tunnels, " ,");
+            while (const char *token = tokenizer.nextToken())
+                trafficClass.tunnelIds.push_back(atoi(token));
+        }
+
+        const char *high = classElem->getAttribute("highWatermark");
+        const char *low = classElem->getAttribute("lowWatermark");
+        const char *sojourn = classElem->getAttribute("maxSojournTime");
+        const char *drops = classElem->getAttribute("maxDropsPerInterval");
+        trafficClass.highWatermark = high ? atoi(high) : par("highWatermark").intValue();
+        trafficClass.lowWatermark = low ? atoi(low) : par("lowWatermark").intValue();
+        trafficClass.maxSojournTime = sojourn ? SimTime::parse(sojourn) : par("maxSojournTime").doubleValue();
+        trafficClass.maxDropsPerInterval = drops ? atol(drops) : par("maxDropsPerInterval").intValue();
+
+        if (trafficClass.highWatermark <= trafficClass.lowWatermark)
+            throw cRuntimeError("highWatermark must be greater than lowWatermark for class %s", name);
+
+        trafficClass.depthVector.reset(new DeadbandVector(this, (trafficClass.name + " queue length").c_str()));
+        trafficClass.sojournVector.reset(new DeadbandVector(this, (trafficClass.name + " sojourn time").c_str()));
+        trafficClass.dropVector.reset(new DeadbandVector(this, (trafficClass.name + " drops").c_str()));
+
+        EV_INFO << "Monitoring class " << name << " on " << queuePath << " for "
+                << trafficClass.tunnelIds.size() << " tunnels" << endl;
+    }
+
+    if (classes.empty())
+        throw cRuntimeError("ClassQueueMonitor configuration contains no classes");
+}
+
+void ClassQueueMonitor::handleMessage(cMessage *msg)
+{
+    if (msg == timer) {
+        poll();
+        scheduleAt(simTime() + interval, timer);
+    }
+    else {
+        delete msg;
+    }
+}
+
+void ClassQueueMonitor::finish()
+{
+    for (auto& trafficClass : classes) {
+        if (trafficClass.queueModule && trafficClass.queueModule->isSubscribed(inet::packetDroppedSignal, this))
+            trafficClass.queueModule->unsubscribe(inet::packetDroppedSignal, this);
+        recordScalar((trafficClass.name + " total drops").c_str(), trafficClass.drops);
+        if (trafficClass.depthVector) {
+            trafficClass.depthVector->flush();
+            trafficClass.sojournVector->flush();
+            trafficClass.dropVector->flush();
+        }
+    }
+
+    cancelAndDelete(timer);
+    timer = nullptr;
+}
+
+void ClassQueueMonitor::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    if (signalID != inet::packetDroppedSignal)
+        return;
+
+    for (auto& trafficClass : classes) {
+        if (trafficClass.queueModule == source) {
+            trafficClass.drops++;
+            break;
+        }
+    }
+}
+
+simtime_t ClassQueueMonitor::getHeadOfLineSojournTime(const TrafficClass& trafficClass) const
+{
+    if (trafficClass.queue->getNumPackets() == 0)
+        return 0;
+
+    // Packets are handed to the queue on arrival at the interface, so the
+    // arrival time of the head-of-line packet approximates its enqueue time
+    inet::Packet *head = trafficClass.queue->getPacket(0);
+    return head ? simTime() - head->getArrivalTime() : SIMTIME_ZERO;
+}
+
+void ClassQueueMonitor::poll()
+{
+    if (!enabled || !rsvp)
+        return;
+
+    for (auto& trafficClass : classes) {
+        int depth = trafficClass.queue->getNumPackets();
+        simtime_t sojourn = getHeadOfLineSojournTime(trafficClass);
+        long intervalDrops = trafficClass.drops - trafficClass.lastDrops;
+        trafficClass.lastDrops = trafficClass.drops;
+
+        trafficClass.depthVector->record(depth);
+        trafficClass.sojournVector->record(sojourn);
+        trafficClass.dropVector->record(intervalDrops);
+
+        bool depthHigh = depth >= trafficClass.highWatermark;
+        bool sojournHigh = trafficClass.maxSojournTime > 0 && sojourn >= trafficClass.maxSojournTime;
+        bool dropsHigh = trafficClass.maxDropsPerInterval > 0 && intervalDrops >= trafficClass.maxDropsPerInterval;
+
+        if (!trafficClass.congested && (depthHigh || sojournHigh || dropsHigh)) {
+            trafficClass.congested = true;
+            EV_WARN << "Class " << trafficClass.name << " congested (depth=" << depth << ", sojourn="
+                    << sojourn << "s, drops=" << intervalDrops << ")" << endl;
+            notifyRsvp(trafficClass, true);
+        }
+        else if (trafficClass.congested && depth <= trafficClass.lowWatermark && intervalDrops == 0
+                 && (trafficClass.maxSojournTime == 0 || sojourn < trafficClass.maxSojournTime / 2))
+        {
+            trafficClass.congested = false;
+            EV_INFO << "Class " << trafficClass.name << " congestion cleared (depth=" << depth
+                    << ", sojourn=" << sojourn << "s)" << endl;
+            notifyRsvp(trafficClass, false);
+        }
+    }
+}
+
+void ClassQueueMonitor::notifyRsvp(const TrafficClass& trafficClass, bool congested)
+{
+    std::string source = getFullPath() + "." + trafficClass.name;
+    for (int tunnelId : trafficClass.tunnelIds)
+        rsvp->handleCongestionNotification(tunnelId, congested, source.c_str());
+}
+
+} // namespace insotu
@@ -0,0 +1,85 @@
+#ifndef __INSOTU_CLASSQUEUEMONITOR_H
+#define __INSOTU_CLASSQUEUEMONITOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+
+#include "DeadbandVector.h"
+
+using namespace omnetpp;
+
+namespace inet {
+namespace queueing {
+class IPacketQueue;
+}
+} // namespace inet
+
+namespace insotu {
+
+class RsvpTeScriptable;
+
+/**
+ * Per-DiffServ-class congestion monitor
+ *
+ * Watches the individual sub-queues of a DiffServ queue (e.g. the class
+ * queues inside DSQueue1) instead of the total queue length. For every
+ * class it tracks:
+ * - queue depth (packets)
+ * - head-of-line sojourn time
+ * - drops during the last check interval
+ *
+ * A congested class only notifies the RSVP-TE module for the tunnels that
+ * are mapped to that class, so a low-class backlog does not move the EF
+ * tunnel and EF starvation is detected even when the total queue is short.
+ */
+class ClassQueueMonitor : public cSimpleModule, public cListener
+{
+  protected:
+    struct TrafficClass {
+        std::string name;
+        cModule *queueModule = nullptr;
+        inet::queueing::IPacketQueue *queue = nullptr;
+        std::vector<int> tunnelIds;
+
+        // Thresholds
+        int highWatermark = 0;
+        int lowWatermark = 0;
+        simtime_t maxSojournTime = 0;   // 0 = not checked
+        long maxDropsPerInterval = 0;   // 0 = not checked
+
+        // State
+        long drops = 0;
+        long lastDrops = 0;
+        bool congested = false;
+
+        // Statistics
+        std::unique_ptr<DeadbandVector> depthVector;
+        std::unique_ptr<DeadbandVector> sojournVector;
+        std::unique_ptr<DeadbandVector> dropVector;
+    };
+
+    std::vector<TrafficClass> classes;
+    insotu::RsvpTeScriptable *rsvp = nullptr;
+    cMessage *timer = nullptr;
+    simtime_t interval = 0;
+    bool enabled = true;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
+
+    void readClasses(const cXMLElement *config);
+    void poll();
+    simtime_t getHeadOfLineSojournTime(const TrafficClass& trafficClass) const;
+    void notifyRsvp(const TrafficClass& trafficClass, bool congested);
+};
+
+} // namespace insotu
+
+#endif
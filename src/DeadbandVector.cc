@@ -0,0 +1,81 @@
+#include "DeadbandVector.h"
+
+namespace insotu {
+
+Register_PerObjectConfigOption(CFGID_VECTOR_DEADBAND, "vector-deadband", KIND_VECTOR, CFG_DOUBLE, "0",
+        "Deadband of insotu monitor vectors and of the \"deadband\" recording mode, in units of the recorded value; 0 records every sample");
+Register_PerObjectConfigOption(CFGID_VECTOR_DEADBAND_SLOPE, "vector-deadband-slope", KIND_VECTOR, CFG_BOOL, "false",
+        "Predict from the slope of the last two written samples instead of holding the last one");
+Register_PerObjectConfigOptionU(CFGID_VECTOR_DEADBAND_MAX_INTERVAL, "vector-deadband-max-interval", KIND_VECTOR, "s", "0s",
+        "Longest time without a written sample when deadband compression is on; 0 for no limit");
+Register_PerObjectConfigOptionU(CFGID_VECTOR_DEADBAND_BUCKET, "vector-deadband-bucket", KIND_VECTOR, "s", "0s",
+        "Length of the buckets whose minimum and maximum are recorded alongside a deadband compressed vector; 0 for none");
+
+Register_ResultRecorder("deadband", DeadbandRecorder);
+
+DeadbandVector::DeadbandVector(cComponent *owner, const char *name, const char *configPath) :
+    vector(name)
+{
+    std::string path = configPath ? configPath : owner->getFullPath() + "." + name;
+    cConfiguration *cfg = getEnvir()->getConfig();
+    double deadband = cfg->getAsDouble(path.c_str(), CFGID_VECTOR_DEADBAND);
+    if (deadband < 0)
+        throw cRuntimeError("vector-deadband of '%s' must not be negative", path.c_str());
+    double bucketLength = cfg->getAsDouble(path.c_str(), CFGID_VECTOR_DEADBAND_BUCKET);
+    compressor.configure(deadband, cfg->getAsBool(path.c_str(), CFGID_VECTOR_DEADBAND_SLOPE),
+            cfg->getAsDouble(path.c_str(), CFGID_VECTOR_DEADBAND_MAX_INTERVAL), bucketLength);
+
+    if (compressor.isEnabled() && bucketLength > 0) {
+        minVector.reset(new cOutVector((std::string(name) + ":bucketMin").c_str()));
+        maxVector.reset(new cOutVector((std::string(name) + ":bucketMax").c_str()));
+    }
+}
+
+void DeadbandVector::recordWithTimestamp(simtime_t t, double value)
+{
+    if (!compressor.isEnabled()) {
+        vector.recordWithTimestamp(t, value);
+        return;
+    }
+    compressor.offer(t, value, [this](simtime_t time, double v) { writeSample(time, v); },
+            [this](simtime_t time, double min, double max) { writeSummary(time, min, max); });
+}
+
+void DeadbandVector::flush()
+{
+    if (!compressor.isEnabled())
+        return;
+    compressor.flush(simTime(), [this](simtime_t time, double v) { writeSample(time, v); },
+            [this](simtime_t time, double min, double max) { writeSummary(time, min, max); });
+}
+
+void DeadbandVector::writeSample(simtime_t t, double value)
+{
+    vector.recordWithTimestamp(t, value);
+}
+
+void DeadbandVector::writeSummary(simtime_t t, double min, double max)
+{
+    if (!minVector)
+        return;
+    minVector->recordWithTimestamp(t, min);
+    maxVector->recordWithTimestamp(t, max);
+}
+
+void DeadbandRecorder::collect(simtime_t_cref t, double value, cObject *details)
+{
+    // Created on the first sample, in the context of the emitting module
+    if (!vector) {
+        std::string path = getComponent()->getFullPath() + "." + getStatisticName();
+        vector.reset(new DeadbandVector(getComponent(), (std::string(getStatisticName()) + ":vector").c_str(), path.c_str()));
+    }
+    vector->recordWithTimestamp(t, value);
+}
+
+void DeadbandRecorder::finish(cResultFilter *prev)
+{
+    if (vector)
+        vector->flush();
+}
+
+} // namespace insotu
@@ -0,0 +1,206 @@
+#ifndef __INSOTU_DEADBANDVECTOR_H
+#define __INSOTU_DEADBANDVECTOR_H
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <omnetpp.h>
+
+using namespace omnetpp;
+
+namespace insotu {
+
+/**
+ * Deadband compression of a sampled time series
+ *
+ * A sample is written only when it is more than deadband away from the
+ * value predicted from the written ones: the last written value (hold), or
+ * with slope enabled the line through the last two written samples. In
+ * slope mode the last suppressed sample is written first as the end of the
+ * segment. Reconstructing the series with sample-hold (linear in slope
+ * mode) interpolation is thus accurate to within deadband. A sample is also
+ * written after maxInterval without one (keepalive).
+ *
+ * Optionally the minimum and maximum of every bucketLength bucket are
+ * reported as well, so short excursions inside the deadband stay visible.
+ */
+class DeadbandCompressor
+{
+  protected:
+    double deadband = 0;
+    bool slope = false;
+    simtime_t maxInterval = 0;
+    simtime_t bucketLength = 0;
+
+    bool hasWritten = false;
+    simtime_t writtenTime;
+    double writtenValue = 0;
+    bool hasBefore = false;             // sample written before the last one (slope mode)
+    simtime_t beforeTime;
+    double beforeValue = 0;
+    bool hasPending = false;            // last suppressed sample
+    simtime_t pendingTime;
+    double pendingValue = 0;
+
+    bool bucketOpen = false;
+    simtime_t bucketEnd;
+    double bucketMin = 0;
+    double bucketMax = 0;
+
+    long offered = 0;
+    long written = 0;
+
+  public:
+    void configure(double deadband, bool slope, simtime_t maxInterval, simtime_t bucketLength)
+    {
+        this->deadband = deadband;
+        this->slope = slope;
+        this->maxInterval = maxInterval;
+        this->bucketLength = bucketLength;
+    }
+
+    bool isEnabled() const { return deadband > 0; }
+    long getOffered() const { return offered; }
+    long getWritten() const { return written; }
+
+    // write(time, value) is called for every sample kept, summary(time, min, max) per closed bucket
+    template <typename Write, typename Summary>
+    void offer(simtime_t t, double value, Write write, Summary summary)
+    {
+        offered++;
+        updateBucket(t, value, summary);
+
+        if (!hasWritten) {
+            keep(t, value, write);
+            return;
+        }
+
+        double predicted = writtenValue;
+        if (slope && hasBefore && writtenTime > beforeTime)
+            predicted += (writtenValue - beforeValue) / (writtenTime - beforeTime).dbl() * (t - writtenTime).dbl();
+
+        if (std::fabs(value - predicted) > deadband) {
+            if (slope && hasPending)
+                keep(pendingTime, pendingValue, write);
+            keep(t, value, write);
+        }
+        else if (maxInterval > 0 && t - writtenTime >= maxInterval)
+            keep(t, value, write);
+        else {
+            hasPending = true;
+            pendingTime = t;
+            pendingValue = value;
+        }
+    }
+
+    // Writes the last suppressed sample and the open bucket, e.g. at finish()
+    template <typename Write, typename Summary>
+    void flush(simtime_t now, Write write, Summary summary)
+    {
+        if (hasPending)
+            keep(pendingTime, pendingValue, write);
+        if (bucketOpen) {
+            summary(now, bucketMin, bucketMax);
+            bucketOpen = false;
+        }
+    }
+
+  protected:
+    template <typename Write>
+    void keep(simtime_t t, double value, Write write)
+    {
+        write(t, value);
+        written++;
+        hasBefore = hasWritten;
+        beforeTime = writtenTime;
+        beforeValue = writtenValue;
+        hasWritten = true;
+        writtenTime = t;
+        writtenValue = value;
+        hasPending = false;
+    }
+
+    template <typename Summary>
+    void updateBucket(simtime_t t, double value, Summary summary)
+    {
+        if (bucketLength <= 0)
+            return;
+        if (bucketOpen && t >= bucketEnd) {
+            summary(bucketEnd, bucketMin, bucketMax);
+            bucketOpen = false;
+        }
+        if (!bucketOpen) {
+            // Consecutive buckets stay aligned, after a gap the next one starts at t
+            if (bucketEnd <= t)
+                bucketEnd = bucketEnd > 0 && t - bucketEnd < bucketLength ? bucketEnd + bucketLength : t + bucketLength;
+            bucketOpen = true;
+            bucketMin = bucketMax = value;
+        }
+        bucketMin = std::min(bucketMin, value);
+        bucketMax = std::max(bucketMax, value);
+    }
+};
+
+/**
+ * Output vector with optional deadband compression
+ *
+ * Drop-in for the cOutVectors of the monitors. Configured per vector in
+ * the ini file through the per-object options below, with the object path
+ * <module path>.<vector name>; without vector-deadband every sample is
+ * recorded as by a plain cOutVector:
+ *
+ *   **.vector-deadband = 0.01                  # in units of the value
+ *   **.vector-deadband-slope = true            # linear instead of hold prediction
+ *   **.vector-deadband-max-interval = 1s       # keepalive
+ *   **.vector-deadband-bucket = 1s             # "<name>:bucketMin/Max" vectors
+ *
+ * The same compression is available for signal based statistics as the
+ * "deadband" result recording mode (see DeadbandRecorder).
+ */
+class DeadbandVector
+{
+  protected:
+    cOutVector vector;
+    std::unique_ptr<cOutVector> minVector;
+    std::unique_ptr<cOutVector> maxVector;
+    DeadbandCompressor compressor;
+
+  public:
+    // configPath defaults to the owner's path plus the vector name
+    DeadbandVector(cComponent *owner, const char *name, const char *configPath = nullptr);
+
+    void record(double value) { recordWithTimestamp(simTime(), value); }
+    void record(simtime_t value) { recordWithTimestamp(simTime(), value.dbl()); }
+    void recordWithTimestamp(simtime_t t, double value);
+    void flush();
+
+    const DeadbandCompressor& getCompressor() const { return compressor; }
+
+  protected:
+    void writeSample(simtime_t t, double value);
+    void writeSummary(simtime_t t, double min, double max);
+};
+
+/**
+ * Result recorder "deadband": records a statistic like "vector" (under the
+ * same "<statistic>:vector" name), compressed with the vector-deadband
+ * options of the object path <module path>.<statistic name>, e.g.
+ *
+ *   **.queue.queueLength.result-recording-modes = -vector,+deadband
+ *   **.queue.queueLength.vector-deadband = 2
+ */
+class DeadbandRecorder : public cNumericResultRecorder
+{
+  protected:
+    std::unique_ptr<DeadbandVector> vector;
+
+  protected:
+    virtual void collect(simtime_t_cref t, double value, cObject *details) override;
+
+  public:
+    virtual void finish(cResultFilter *prev) override;
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,284 @@
+#include "EgressSlaMonitor.h"
+
+#include "MplsScriptable.h"
+#include "RsvpTeScriptable.h"
+#include "inet/applications/base/ApplicationPacket_m.h"
+#include "inet/common/TimeTag_m.h"
+#include "inet/common/packet/Packet.h"
+#include "inet/networklayer/ipv4/Ipv4Header_m.h"
+#include "inet/networklayer/mpls/MplsPacket_m.h"
+#include "inet/transportlayer/udp/UdpHeader_m.h"
+#include <cmath>
+#include <omnetpp.h>
+
+namespace insotu {
+
+using namespace omnetpp;
+
+Define_Module(EgressSlaMonitor);
+
+void EgressSlaMonitor::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled");
+        if (!enabled)
+            return;
+
+        interval = par("checkInterval");
+        violationIntervals = par("violationIntervals");
+        clearIntervals = par("clearIntervals");
+        minPackets = par("minPackets");
+        if (interval <= 0 || violationIntervals < 1 || clearIntervals < 1)
+            throw cRuntimeError("checkInterval must be positive and violationIntervals/clearIntervals at least 1");
+
+        const char *mplsPath = par("mplsModule");
+        mpls = dynamic_cast<insotu::MplsScriptable *>(getModuleByPath(mplsPath));
+        if (!mpls)
+            throw cRuntimeError("MPLS module '%s' is not an insotu MplsScriptable", mplsPath);
+
+        const char *rsvpPath = par("rsvpModule");
+        cModule *rsvpModule = rsvpPath && *rsvpPath ? getModuleByPath(rsvpPath) : nullptr;
+        rsvp = rsvpModule ? dynamic_cast<insotu::RsvpTeScriptable *>(rsvpModule) : nullptr;
+        if (!rsvp)
+            throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
+
+        readSla(par("sla").xmlValue());
+
+        timer = new cMessage("evaluateSla");
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (enabled && timer) {
+            mpls->setSlaMonitor(this);
+            scheduleAt(simTime() + interval, timer);
+        }
+    }
+}
+
+void EgressSlaMonitor::readSla(const cXMLElement *config)
+{
+    if (!config)
+        throw cRuntimeError("EgressSlaMonitor requires an sla configuration");
+
+    for (cXMLElement *elem : config->getChildrenByTagName("tunnel")) {
+        const char *id = elem->getAttribute("id");
+        if (!id)
+            throw cRuntimeError("SLA entry requires an 'id' attribute at %s", elem->getSourceLocation());
+
+        int tunnelId = atoi(id);
+        TunnelSla& sla = tunnels[tunnelId];
+        sla.tunnelId = tunnelId;
+
+        const char *throughput = elem->getAttribute("minThroughput");
+        const char *delay = elem->getAttribute("maxDelay");
+        const char *jitter = elem->getAttribute("maxJitter");
+        const char *loss = elem->getAttribute("maxLoss");
+        sla.minThroughput = throughput ? cValue::parseQuantity(throughput, "bps") : 0;
+        sla.maxDelay = delay ? SimTime::parse(delay) : SIMTIME_ZERO;
+        sla.maxJitter = jitter ? SimTime::parse(jitter) : SIMTIME_ZERO;
+        sla.maxLoss = loss ? atof(loss) : 0;
+
+        std::string prefix = "tunnel " + std::to_string(tunnelId);
+        sla.throughputVector.reset(new DeadbandVector(this, (prefix + " egress throughput").c_str()));
+        sla.delayVector.reset(new DeadbandVector(this, (prefix + " egress one-way delay").c_str()));
+        sla.jitterVector.reset(new DeadbandVector(this, (prefix + " egress jitter").c_str()));
+        sla.lossVector.reset(new DeadbandVector(this, (prefix + " egress loss").c_str()));
+
+        EV_INFO << "Monitoring SLA of tunnel " << tunnelId << ": minThroughput=" << sla.minThroughput
+                << "bps maxDelay=" << sla.maxDelay << " maxJitter=" << sla.maxJitter
+                << " maxLoss=" << sla.maxLoss << endl;
+    }
+
+    if (tunnels.empty())
+        throw cRuntimeError("EgressSlaMonitor configuration contains no tunnels");
+}
+
+void EgressSlaMonitor::handleMessage(cMessage *msg)
+{
+    if (msg == timer) {
+        evaluate();
+        scheduleAt(simTime() + interval, timer);
+    }
+    else {
+        delete msg;
+    }
+}
+
+void EgressSlaMonitor::finish()
+{
+    if (mpls)
+        mpls->setSlaMonitor(nullptr);
+
+    for (auto& elem : tunnels) {
+        recordScalar(("tunnel " + std::to_string(elem.first) + " SLA violations").c_str(), elem.second.violations);
+        if (elem.second.throughputVector) {
+            elem.second.throughputVector->flush();
+            elem.second.delayVector->flush();
+            elem.second.jitterVector->flush();
+            elem.second.lossVector->flush();
+        }
+    }
+
+    cancelAndDelete(timer);
+    timer = nullptr;
+}
+
+void EgressSlaMonitor::observeLspPacket(int inLabel, const inet::Packet *packet)
+{
+    Enter_Method_Silent();
+
+    auto lspIt = labelLsps.find(inLabel);
+    if (lspIt == labelLsps.end()) {
+        // New label after (re-)signalling: refresh at once, but only once per
+        // unknown label and interval
+        if (!unknownLabels.insert(inLabel).second)
+            return;
+        rsvp->collectEgressLabels(labelLsps);
+        lspIt = labelLsps.find(inLabel);
+        if (lspIt == labelLsps.end())
+            return;
+    }
+    auto tunnelIt = tunnels.find(lspIt->second.first);
+    if (tunnelIt == tunnels.end())
+        return;
+
+    TunnelSla& sla = tunnelIt->second;
+    if (sla.lspId != lspIt->second.second) {
+        sla.lspId = lspIt->second.second;
+        sla.lspSince = simTime();
+    }
+    measurePacket(sla, packet);
+}
+
+
+void EgressSlaMonitor::measurePacket(TunnelSla& sla, const inet::Packet *packet)
+{
+    sla.packets++;
+    sla.bytes += packet->getByteLength();
+
+    // One-way delay from the creation time the application tagged its data with
+    simtime_t created = -1;
+    for (const auto& region : packet->peekData()->getAllTags<inet::CreationTimeTag>()) {
+        simtime_t time = region.getTag()->getCreationTime();
+        if (created < 0 || time < created)
+            created = time;
+    }
+    if (created >= 0) {
+        simtime_t delay = simTime() - created;
+        sla.delaySum += delay;
+        sla.delaySamples++;
+        if (sla.lastDelay >= 0)
+            sla.jitter += (std::fabs((delay - sla.lastDelay).dbl()) - sla.jitter) / 16;
+        sla.lastDelay = delay;
+    }
+
+    // Loss from sequence number gaps of UDP application flows below the label stack
+    try {
+        inet::B offset = inet::B(0);
+        for (;;) {
+            const auto& mplsHeader = packet->peekDataAt<inet::MplsHeader>(offset);
+            offset = offset + mplsHeader->getChunkLength();
+            if (mplsHeader->getS())
+                break;
+        }
+
+        const auto& ipHeader = packet->peekDataAt<inet::Ipv4Header>(offset);
+        if (ipHeader->getProtocolId() != inet::IP_PROT_UDP)
+            return;
+        offset = offset + ipHeader->getHeaderLength();
+        const auto& udpHeader = packet->peekDataAt<inet::UdpHeader>(offset);
+        const auto& appPacket = packet->peekDataAt<inet::ApplicationPacket>(offset + inet::UDP_HEADER_LENGTH);
+
+        auto flow = std::make_pair(ipHeader->getSrcAddress().getInt(), udpHeader->getSourcePort());
+        long sequenceNumber = appPacket->getSequenceNumber();
+        auto it = sla.lastSequence.find(flow);
+        if (it == sla.lastSequence.end())
+            sla.lastSequence[flow] = sequenceNumber;
+        else if (sequenceNumber > it->second) {
+            sla.lost += sequenceNumber - it->second - 1;
+            it->second = sequenceNumber;
+        }
+    }
+    catch (const std::exception& e) {
+        EV_DEBUG << "Packet without UDP application payload, not used for loss: " << e.what() << endl;
+    }
+}
+
+void EgressSlaMonitor::evaluate()
+{
+    // Labels change when LSPs are re-signalled
+    rsvp->collectEgressLabels(labelLsps);
+    unknownLabels.clear();
+
+    for (auto& elem : tunnels) {
+        TunnelSla& sla = elem.second;
+
+        double throughput = sla.bytes * 8.0 / interval.dbl();
+        double delay = sla.delaySamples > 0 ? sla.delaySum.dbl() / sla.delaySamples : 0;
+        double loss = sla.packets + sla.lost > 0 ? (double)sla.lost / (sla.packets + sla.lost) : 0;
+
+        sla.throughputVector->record(throughput);
+        if (sla.delaySamples > 0) {
+            sla.delayVector->record(delay);
+            sla.jitterVector->record(sla.jitter);
+        }
+        sla.lossVector->record(loss);
+
+        if (checkTunnel(sla, throughput, delay, loss)) {
+            sla.badIntervals = 0;
+            if (++sla.goodIntervals >= clearIntervals && sla.violated) {
+                sla.violated = false;
+                EV_INFO << "Tunnel " << sla.tunnelId << " complies with its SLA again" << endl;
+                rsvp->sendSlaNotify(sla.tunnelId, false, getFullPath().c_str());
+            }
+        }
+        else {
+            sla.goodIntervals = 0;
+            if (++sla.badIntervals >= violationIntervals && !sla.violated) {
+                sla.violated = true;
+                sla.violations++;
+                EV_WARN << "Tunnel " << sla.tunnelId << " violates its SLA, notifying headend" << endl;
+                rsvp->sendSlaNotify(sla.tunnelId, true, getFullPath().c_str());
+            }
+        }
+
+        sla.packets = 0;
+        sla.lost = 0;
+        sla.bytes = 0;
+        sla.delaySum = 0;
+        sla.delaySamples = 0;
+    }
+}
+
+bool EgressSlaMonitor::checkTunnel(const TunnelSla& sla, double throughput, double delay, double loss)
+{
+    // Throughput is also checked without traffic, so a black-holed LSP is detected, but
+    // only once the current LSP has carried traffic for a whole interval: before the
+    // applications start and after a switch the interval is partial
+    bool settled = sla.lspId >= 0 && simTime() - sla.lspSince >= interval;
+    if (sla.minThroughput > 0 && settled && throughput < sla.minThroughput) {
+        EV_DETAIL << "Tunnel " << sla.tunnelId << " throughput " << throughput << "bps below " << sla.minThroughput << "bps" << endl;
+        return false;
+    }
+
+    // Delay, jitter and loss need enough packets to be meaningful
+    if (sla.packets < minPackets)
+        return true;
+
+    if (sla.maxDelay > 0 && sla.delaySamples > 0 && delay > sla.maxDelay.dbl()) {
+        EV_DETAIL << "Tunnel " << sla.tunnelId << " delay " << delay << "s above " << sla.maxDelay << endl;
+        return false;
+    }
+    if (sla.maxJitter > 0 && sla.jitter > sla.maxJitter.dbl()) {
+        EV_DETAIL << "Tunnel " << sla.tunnelId << " jitter " << sla.jitter << "s above " << sla.maxJitter << endl;
+        return false;
+    }
+    if (sla.maxLoss > 0 && loss > sla.maxLoss) {
+        EV_DETAIL << "Tunnel " << sla.tunnelId << " loss " << loss << " above " << sla.maxLoss << endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace insotu
@@ -0,0 +1,108 @@
+#ifndef __INSOTU_EGRESSSLAMONITOR_H
+#define __INSOTU_EGRESSSLAMONITOR_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include <utility>
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+
+#include "DeadbandVector.h"
+
+using namespace omnetpp;
+
+namespace inet {
+class Packet;
+} // namespace inet
+
+namespace insotu {
+
+class MplsScriptable;
+class RsvpTeScriptable;
+
+/**
+ * Egress-side per-tunnel SLA monitor
+ *
+ * Observes the labelled packets arriving at the egress LER (through
+ * MplsScriptable) and measures per tunnel, over every check interval:
+ * - received throughput
+ * - mean one-way delay (from the application's creation time tags)
+ * - jitter (RFC 3550 smoothed delay variation)
+ * - loss (gaps in the application sequence numbers of each UDP flow)
+ *
+ * A tunnel violating its SLA targets for violationIntervals consecutive
+ * intervals is reported to its headend with an in-band Notify-style RSVP
+ * message, so the headend fails over on degradation anywhere along the
+ * LSP; compliance for clearIntervals intervals clears the report.
+ */
+class EgressSlaMonitor : public cSimpleModule
+{
+  protected:
+    struct TunnelSla {
+        int tunnelId = -1;
+
+        // Targets (0 = not checked)
+        double minThroughput = 0;       // bps
+        simtime_t maxDelay = 0;
+        simtime_t maxJitter = 0;
+        double maxLoss = 0;             // fraction
+
+        // Current interval
+        long packets = 0;
+        long lost = 0;
+        int64_t bytes = 0;
+        simtime_t delaySum = 0;
+        long delaySamples = 0;
+
+        // Running state
+        int lspId = -1;                 // LSP the tunnel's packets last arrived on
+        simtime_t lspSince;             // since when
+        simtime_t lastDelay = -1;
+        double jitter = 0;              // seconds
+        std::map<std::pair<uint32_t, int>, long> lastSequence;   // (source address, port) -> sequence number
+        int badIntervals = 0;
+        int goodIntervals = 0;
+        bool violated = false;
+        long violations = 0;
+
+        // Statistics
+        std::unique_ptr<DeadbandVector> throughputVector;
+        std::unique_ptr<DeadbandVector> delayVector;
+        std::unique_ptr<DeadbandVector> jitterVector;
+        std::unique_ptr<DeadbandVector> lossVector;
+    };
+
+    std::map<int, TunnelSla> tunnels;
+    std::map<int, std::pair<int, int>> labelLsps;   // in-label -> (tunnelId, lspId)
+    std::set<int> unknownLabels;                    // not in labelLsps at the last refresh
+
+    MplsScriptable *mpls = nullptr;
+    RsvpTeScriptable *rsvp = nullptr;
+    cMessage *timer = nullptr;
+    simtime_t interval = 0;
+    int violationIntervals = 0;
+    int clearIntervals = 0;
+    long minPackets = 0;
+    bool enabled = true;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    void readSla(const cXMLElement *config);
+    void evaluate();
+    bool checkTunnel(const TunnelSla& sla, double throughput, double delay, double loss);
+    void measurePacket(TunnelSla& sla, const inet::Packet *packet);
+
+  public:
+    // Called by MplsScriptable for every labelled packet arriving at this router
+    void observeLspPacket(int inLabel, const inet::Packet *packet);
+};
+
+} // namespace insotu
+
+#endif
@@ -1,9 +1,12 @@
 #include "EnhancedLinkMonitor.h"
+#include "FluidLinkLoad.h"
 #include "RsvpTeScriptable.h"
+#include "inet/common/Simsignals.h"
 #include "inet/queueing/contract/IPacketQueue.h"
 #include "inet/networklayer/common/NetworkInterface.h"
 #include <omnetpp.h>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 
 namespace insotu {
@@ -42,6 +45,24 @@ void EnhancedLinkMonitor::initialize(int stage)
             monitorWindowSize = par("monitorWindowSize").intValue();
         if (hasPar("historySize"))
             historySize = par("historySize").intValue();
+        if (hasPar("lossWindow"))
+            lossWindow = par("lossWindow").doubleValue();
+        if (hasPar("minLossSamples"))
+            minLossSamples = par("minLossSamples").intValue();
+        if (hasPar("expectExternalReports"))
+            expectExternalReports = par("expectExternalReports").boolValue();
+        int lossBucketCount = hasPar("lossBucketCount") ? par("lossBucketCount").intValue() : 10;
+        if (lossWindow <= 0 || lossBucketCount <= 0)
+            throw cRuntimeError("lossWindow and lossBucketCount must be positive");
+        lossBuckets.assign(lossBucketCount, LossBucket());
+        lossBucketLength = lossWindow / lossBucketCount;
+        if (hasPar("adaptiveSampling") && par("adaptiveSampling").boolValue()) {
+            double minInterval = par("minCheckInterval").doubleValue();
+            double maxInterval = par("maxCheckInterval").doubleValue();
+            if (minInterval <= 0 || minInterval > maxInterval)
+                throw cRuntimeError("minCheckInterval must be positive and not greater than maxCheckInterval");
+            sampling.configure(true, minInterval, maxInterval);
+        }
 
         // Validate parameters
         if (highWatermark <= lowWatermark)
@@ -61,18 +82,36 @@ void EnhancedLinkMonitor::initialize(int stage)
         if (!rsvp)
             throw cRuntimeError("RSVP module '%s' is not an insotu::RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
 
-        // Optional interface module for link status monitoring
-        // Note: NetworkInterface is not a cModule, so this feature is currently disabled
-        // To enable, you would need to access the interface through InterfaceTable
+        // Optional interface module: source of the drop/transmit signals (those
+        // of the queue propagate to it, and it reports drops of its own, e.g.
+        // while down) and, if it is a NetworkInterface, of the link status
+        signalSource = queueModule;
         if (hasPar("interfaceModule")) {
             const char *ifacePath = par("interfaceModule").stringValue();
             if (ifacePath && *ifacePath) {
-                // TODO: Implement interface lookup via InterfaceTable
-                EV_WARN << "Interface monitoring via interfaceModule parameter is not yet implemented" << std::endl;
-                EV_WARN << "To monitor link status, use queue-based monitoring instead" << std::endl;
+                cModule *ifaceModule = getModuleByPath(ifacePath);
+                if (!ifaceModule)
+                    throw cRuntimeError("Interface module '%s' not found", ifacePath);
+                signalSource = ifaceModule;
+                interface = dynamic_cast<NetworkInterface *>(ifaceModule);
             }
         }
 
+        // Fluid background load module (optional)
+        const char *fluidPath = hasPar("fluidModule") ? par("fluidModule").stringValue() : "";
+        if (fluidPath && *fluidPath) {
+            fluid = dynamic_cast<insotu::FluidLinkLoad *>(getModuleByPath(fluidPath));
+            if (!fluid)
+                throw cRuntimeError("Fluid module '%s' is not an insotu FluidLinkLoad", fluidPath);
+            fluidPacketSize = par("fluidPacketSize").doubleValue();
+            if (fluidPacketSize <= 0)
+                throw cRuntimeError("fluidPacketSize must be positive");
+        }
+
+        // Packet loss accounting from drop and transmit signals
+        signalSource->subscribe(inet::packetPulledSignal, this);
+        signalSource->subscribe(inet::packetDroppedSignal, this);
+
         // Initialize timer
         pollTimer = new cMessage("pollTimer");
 
@@ -87,6 +126,9 @@ void EnhancedLinkMonitor::initialize(int stage)
         WATCH(highUtilization);
         WATCH(packetsSent);
         WATCH(packetsDropped);
+        WATCH(externalLatencyReports);
+        WATCH(externalSentReports);
+        WATCH(externalDropReports);
 
         EV_INFO << "EnhancedLinkMonitor initialized for tunnel " << tunnelId << std::endl;
     }
@@ -100,7 +142,7 @@ void EnhancedLinkMonitor::handleMessage(cMessage *msg)
 {
     if (msg == pollTimer) {
         performChecks();
-        scheduleAt(simTime() + checkInterval, pollTimer);
+        scheduleAt(simTime() + sampling.nextInterval(checkInterval.dbl()), pollTimer);
     }
     else {
         delete msg;
@@ -112,6 +154,12 @@ void EnhancedLinkMonitor::finish()
     cancelAndDelete(pollTimer);
     pollTimer = nullptr;
 
+    if (signalSource) {
+        signalSource->unsubscribe(inet::packetPulledSignal, this);
+        signalSource->unsubscribe(inet::packetDroppedSignal, this);
+        signalSource = nullptr;
+    }
+
     // Record final statistics
     if (enabled) {
         recordScalar("finalPacketsSent", packetsSent);
@@ -120,6 +168,14 @@ void EnhancedLinkMonitor::finish()
             double lossRate = (double)packetsDropped / (double)packetsSent;
             recordScalar("finalPacketLossRate", lossRate);
         }
+        recordScalar("externalLatencyReports", externalLatencyReports);
+        recordScalar("externalSentReports", externalSentReports);
+        recordScalar("externalDropReports", externalDropReports);
+
+        if (expectExternalReports && (externalLatencyReports == 0 || externalSentReports == 0))
+            EV_WARN << "EnhancedLinkMonitor of tunnel " << tunnelId << " received " << externalLatencyReports
+                    << " latency and " << externalSentReports << " sent-packet reports, expected both"
+                    << " (is it listed in the probe generator's monitorModules?)" << std::endl;
     }
 }
 
@@ -131,6 +187,7 @@ void EnhancedLinkMonitor::performChecks()
     EV_DEBUG << "Performing link checks at t=" << simTime() << std::endl;
 
     // Perform all monitoring checks
+    sampling.reset();
     checkQueueCongestion();
     checkLinkStatus();
     checkPacketLoss();
@@ -140,9 +197,17 @@ void EnhancedLinkMonitor::performChecks()
     lastCheckTime = simTime();
 }
 
+int EnhancedLinkMonitor::getQueueDepth()
+{
+    int depth = queue->getNumPackets();
+    if (fluid)
+        depth += (int)(fluid->getBacklogBytes() / fluidPacketSize);
+    return depth;
+}
+
 void EnhancedLinkMonitor::checkQueueCongestion()
 {
-    int queueLength = queue->getNumPackets();
+    int queueLength = getQueueDepth();
 
     // Update history
     queueLengthHistory.push_back(queueLength);
@@ -169,6 +234,8 @@ void EnhancedLinkMonitor::checkQueueCongestion()
     if (congested != wasCongested) {
         emit(registerSignal("congestionState"), congested ? 1 : 0);
     }
+
+    sampling.note(avgQueueLength, congested ? lowWatermark : highWatermark, highWatermark - lowWatermark);
 }
 
 void EnhancedLinkMonitor::checkLinkStatus()
@@ -198,6 +265,7 @@ void EnhancedLinkMonitor::checkLinkStatus()
 
 void EnhancedLinkMonitor::checkPacketLoss()
 {
+    countFluidLoss();
     double lossRate = calculatePacketLossRate();
     bool wasHighLoss = highLoss;
 
@@ -217,6 +285,8 @@ void EnhancedLinkMonitor::checkPacketLoss()
         emit(registerSignal("packetLossState"), highLoss ? 1 : 0);
     }
 
+    sampling.note(lossRate, highLoss ? lossRateThreshold * 0.5 : lossRateThreshold, lossRateThreshold * 0.5);
+
     recordScalar("currentPacketLossRate", lossRate);
 }
 
@@ -243,6 +313,9 @@ void EnhancedLinkMonitor::checkLatency()
     if (highLatency != wasHighLatency) {
         emit(registerSignal("latencyState"), highLatency ? 1 : 0);
     }
+
+    double latencyLimit = latencyThreshold.dbl();
+    sampling.note(avgLatency, highLatency ? latencyLimit * 0.7 : latencyLimit, latencyLimit * 0.3);
 }
 
 void EnhancedLinkMonitor::checkUtilization()
@@ -266,6 +339,8 @@ void EnhancedLinkMonitor::checkUtilization()
         emit(registerSignal("utilizationState"), highUtilization ? 1 : 0);
     }
 
+    sampling.note(utilization, highUtilization ? utilizationThreshold * 0.7 : utilizationThreshold, utilizationThreshold * 0.3);
+
     recordScalar("currentUtilization", utilization);
 }
 
@@ -280,10 +355,87 @@ double EnhancedLinkMonitor::calculateAverageQueueLength()
 
 double EnhancedLinkMonitor::calculatePacketLossRate()
 {
-    if (packetsSent == 0)
+    advanceLossWindow();
+    if (windowOffered == 0 || windowOffered < minLossSamples)
         return 0.0;
 
-    return (double)packetsDropped / (double)packetsSent;
+    return std::min(1.0, (double)windowDropped / (double)windowOffered);
+}
+
+void EnhancedLinkMonitor::countFluidLoss()
+{
+    if (!fluid)
+        return;
+
+    // Fluid since the last check, in whole packet-equivalents; the remainder
+    // is carried over to the next check
+    double served = fluid->getServedBytes();
+    double dropped = fluid->getDroppedBytes();
+    long servedPackets = (long)((served - lastFluidServed) / fluidPacketSize);
+    long droppedPackets = (long)((dropped - lastFluidDropped) / fluidPacketSize);
+    lastFluidServed += servedPackets * fluidPacketSize;
+    lastFluidDropped += droppedPackets * fluidPacketSize;
+
+    advanceLossWindow();
+    LossBucket& bucket = lossBuckets[lossBucketIndex % lossBuckets.size()];
+    bucket.offered += servedPackets + droppedPackets;
+    bucket.dropped += droppedPackets;
+    windowOffered += servedPackets + droppedPackets;
+    windowDropped += droppedPackets;
+}
+
+void EnhancedLinkMonitor::advanceLossWindow()
+{
+    int64_t index = (int64_t)std::floor(simTime() / lossBucketLength);
+    if (index <= lossBucketIndex)
+        return;
+
+    // Clear the buckets that slid out of the window since the last update
+    int64_t expired = std::min<int64_t>(index - lossBucketIndex, lossBuckets.size());
+    for (int64_t i = 1; i <= expired; i++) {
+        LossBucket& bucket = lossBuckets[(lossBucketIndex + i) % lossBuckets.size()];
+        windowOffered -= bucket.offered;
+        windowDropped -= bucket.dropped;
+        bucket = LossBucket();
+    }
+    lossBucketIndex = index;
+}
+
+void EnhancedLinkMonitor::countLossSample(bool offered, bool dropped)
+{
+    advanceLossWindow();
+    LossBucket& bucket = lossBuckets[lossBucketIndex % lossBuckets.size()];
+    if (offered) {
+        bucket.offered++;
+        windowOffered++;
+        packetsSent++;
+    }
+    if (dropped) {
+        bucket.dropped++;
+        windowDropped++;
+        packetsDropped++;
+    }
+}
+
+void EnhancedLinkMonitor::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    // Pulled packets go to the transmitter; dropped ones never reach it.
+    // Signals of the submodules propagate to signalSource, so the same packet
+    // arrives once per module on its way; count it only the first time
+    auto packet = dynamic_cast<cMessage *>(obj);
+    msgid_t packetId = packet ? packet->getId() : -1;
+    if (signalID == inet::packetPulledSignal) {
+        if (packetId != -1 && packetId == lastPulledPacketId)
+            return;
+        lastPulledPacketId = packetId;
+        countLossSample(true, false);
+    }
+    else if (signalID == inet::packetDroppedSignal) {
+        if (packetId != -1 && packetId == lastDroppedPacketId)
+            return;
+        lastDroppedPacketId = packetId;
+        countLossSample(true, true);
+    }
 }
 
 double EnhancedLinkMonitor::calculateAverageLatency()
@@ -291,11 +443,7 @@ double EnhancedLinkMonitor::calculateAverageLatency()
     if (latencySamples.empty())
         return 0.0;
 
-    double sum = 0.0;
-    for (const auto &sample : latencySamples)
-        sum += sample.dbl();
-
-    return sum / latencySamples.size();
+    return latencySum.dbl() / latencySamples.size();
 }
 
 double EnhancedLinkMonitor::calculateUtilization()
@@ -308,8 +456,8 @@ double EnhancedLinkMonitor::calculateUtilization()
     if (maxCapacity <= 0)
         return 0.0;
 
-    int currentOccupancy = queue->getNumPackets();
-    return (double)currentOccupancy / (double)maxCapacity;
+    int currentOccupancy = getQueueDepth();
+    return std::min(1.0, (double)currentOccupancy / (double)maxCapacity);
 }
 
 void EnhancedLinkMonitor::notifyRsvp(const char *reason, bool critical)
@@ -327,21 +475,34 @@ void EnhancedLinkMonitor::notifyRsvp(const char *reason, bool critical)
 
 void EnhancedLinkMonitor::reportPacketDrop()
 {
-    packetsDropped++;
+    // Loss of a packet already reported as sent
+    externalDropReports++;
+    countLossSample(false, true);
 }
 
 void EnhancedLinkMonitor::reportPacketSent()
 {
-    packetsSent++;
+    externalSentReports++;
+    countLossSample(true, false);
 }
 
 void EnhancedLinkMonitor::reportLatency(simtime_t latency)
 {
-    latencySamples.push_back(latency);
+    externalLatencyReports++;
 
-    // Keep only recent samples
-    if ((int)latencySamples.size() > monitorWindowSize)
-        latencySamples.erase(latencySamples.begin());
+    // Keep only recent samples, overwriting the oldest one once the window is full
+    if ((int)latencySamples.size() < monitorWindowSize) {
+        latencySamples.push_back(latency);
+    }
+    else if (!latencySamples.empty()) {
+        latencySum -= latencySamples[latencyNextIndex];
+        latencySamples[latencyNextIndex] = latency;
+        latencyNextIndex = (latencyNextIndex + 1) % latencySamples.size();
+    }
+    else {
+        return;
+    }
+    latencySum += latency;
 }
 
 } // namespace insotu
@@ -3,6 +3,7 @@
 
 #include <omnetpp.h>
 #include "inet/common/InitStages.h"
+#include "AdaptiveSampling.h"
 #include <vector>
 #include <map>
 
@@ -17,6 +18,7 @@ class NetworkInterface;
 
 namespace insotu {
 
+class FluidLinkLoad;
 class RsvpTeScriptable;
 
 /**
@@ -31,8 +33,17 @@ class RsvpTeScriptable;
  *
  * When issues are detected, it notifies the RSVP-TE module
  * to trigger path switching to alternate routes.
+ *
+ * Packet loss is taken from the drop and transmit signals of the monitored
+ * interface (or queue) plus external reports, and computed over a sliding
+ * window of lossBucketCount time buckets spanning lossWindow. Signals of the
+ * same packet from nested modules (sub-queues, scheduler) count once.
+ *
+ * With a FluidLinkLoad (fluidModule), the fluid backlog counts towards queue
+ * depth and occupancy, and fluid served/dropped bytes towards the loss window,
+ * all in packet-equivalents of fluidPacketSize bytes.
  */
-class EnhancedLinkMonitor : public cSimpleModule
+class EnhancedLinkMonitor : public cSimpleModule, public cListener
 {
   protected:
     // Configuration parameters
@@ -42,9 +53,14 @@ class EnhancedLinkMonitor : public cSimpleModule
     simtime_t checkInterval = 0;
     bool enabled = true;
 
+    // Adaptive polling: every check notes its distance to the next threshold
+    AdaptiveSampling sampling;
+
     // Loss rate monitoring
     double lossRateThreshold = 0.05;  // 5% packet loss threshold
     int monitorWindowSize = 100;      // Monitor last N packets
+    simtime_t lossWindow = 1;
+    int minLossSamples = 10;          // Fewer packets in the window count as no loss
 
     // Latency monitoring
     simtime_t latencyThreshold = 0.1;  // 100ms threshold
@@ -54,8 +70,13 @@ class EnhancedLinkMonitor : public cSimpleModule
 
     // Module references
     inet::queueing::IPacketQueue *queue = nullptr;
+    cModule *signalSource = nullptr;    // Interface if given, otherwise the queue
     insotu::RsvpTeScriptable *rsvp = nullptr;
     inet::NetworkInterface *interface = nullptr;
+    insotu::FluidLinkLoad *fluid = nullptr;     // optional fluid background load
+    double fluidPacketSize = 0;                 // bytes per packet-equivalent of fluid
+    double lastFluidServed = 0;                 // fluid bytes already counted in the loss window
+    double lastFluidDropped = 0;
 
     // Timer
     cMessage *pollTimer = nullptr;
@@ -72,17 +93,45 @@ class EnhancedLinkMonitor : public cSimpleModule
     long packetsDropped = 0;
     long bytesTransmitted = 0;
     simtime_t lastCheckTime = 0;
+
+    // Loss window: ring of time buckets, lossBucketIndex is the absolute
+    // index (simTime / bucket length) of the current one
+    struct LossBucket {
+        long offered = 0;
+        long dropped = 0;
+    };
+    std::vector<LossBucket> lossBuckets;
+    int64_t lossBucketIndex = 0;
+    simtime_t lossBucketLength = 0;
+    long windowOffered = 0;
+    long windowDropped = 0;
+
+    // Id of the packet last counted per signal: a compound queue (or the
+    // interface) hears the same packet from its sub-queues, scheduler and itself
+    msgid_t lastPulledPacketId = -1;
+    msgid_t lastDroppedPacketId = -1;
+
+    // Latency samples in a ring buffer of monitorWindowSize entries
     std::vector<simtime_t> latencySamples;
+    size_t latencyNextIndex = 0;
+    simtime_t latencySum = 0;
 
     // History for moving average
     std::vector<int> queueLengthHistory;
     int historySize = 10;
 
+    // Reports received through the public interface
+    bool expectExternalReports = false;
+    long externalLatencyReports = 0;
+    long externalSentReports = 0;
+    long externalDropReports = 0;
+
   protected:
     virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
     virtual void initialize(int stage) override;
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
 
     // Monitoring functions
     void performChecks();
@@ -94,12 +143,18 @@ class EnhancedLinkMonitor : public cSimpleModule
 
     // Helper functions
     double calculateAverageQueueLength();
+    int getQueueDepth();
+    void countFluidLoss();
     double calculatePacketLossRate();
+    void advanceLossWindow();
+    void countLossSample(bool offered, bool dropped);
     double calculateAverageLatency();
     double calculateUtilization();
     void notifyRsvp(const char *reason, bool critical);
 
   public:
+    int getTunnelId() const { return tunnelId; }
+
     // Public interface for external notifications
     void reportPacketDrop();
     void reportPacketSent();
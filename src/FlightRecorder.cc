@@ -0,0 +1,113 @@
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+namespace insotu {
+
+void FlightRecorder::setCapacity(size_t capacity)
+{
+    buffer.assign(capacity, Record());
+    next = 0;
+    total = 0;
+}
+
+bool FlightRecorder::dump(const char *filename, int scaleExp) const
+{
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+        return false;
+
+    Header header;
+    memcpy(header.magic, "FLRC", 4);
+    header.version = VERSION;
+    header.recordSize = sizeof(Record);
+    header.scaleExp = scaleExp;
+    header.count = (uint32_t)getCount();
+    header.total = total;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    // Oldest record first: once wrapped, the oldest is at the write position
+    size_t count = getCount();
+    size_t start = total > buffer.size() ? next : 0;
+    size_t firstChunk = std::min(count, buffer.size() - start);
+    if (ok && firstChunk > 0)
+        ok = fwrite(&buffer[start], sizeof(Record), firstChunk, f) == firstChunk;
+    if (ok && count > firstChunk)
+        ok = fwrite(&buffer[0], sizeof(Record), count - firstChunk, f) == count - firstChunk;
+
+    return fclose(f) == 0 && ok;
+}
+
+bool FlightRecorder::decode(const char *filename, std::ostream& out)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    Header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "FLRC", 4) != 0
+        || header.version != VERSION || header.recordSize != sizeof(Record))
+    {
+        fclose(f);
+        return false;
+    }
+
+    double scale = std::pow(10.0, header.scaleExp);
+    out << "# " << header.count << " of " << header.total << " decisions" << std::endl;
+    out << "# seq time tunnel lsp event reason from to label" << std::endl;
+
+    Record r;
+    uint32_t read = 0;
+    while (read < header.count && fread(&r, sizeof(r), 1, f) == 1) {
+        out << r.sequence << ' ' << std::fixed << std::setprecision(6) << (r.time * scale)
+            << std::defaultfloat << ' ' << r.tunnelId << ' ' << r.lspId << ' '
+            << getEventName(r.event) << ' ' << getReasonName(r.reason) << ' '
+            << r.fromIndex << ' ' << r.toIndex << ' ' << r.label << '\n';
+        read++;
+    }
+    fclose(f);
+    out.flush();
+    return read == header.count;
+}
+
+FlightRecorder::Reason FlightRecorder::classifyReason(const char *reason)
+{
+    if (!reason)
+        return REASON_OTHER;
+    if (!strcmp(reason, "PATH_NOTIFY"))
+        return REASON_PATH_NOTIFY;
+    if (!strcmp(reason, "scenario command"))
+        return REASON_SCENARIO;
+    if (!strcmp(reason, "delayed_restoration"))
+        return REASON_DELAYED_RESTORATION;
+    if (!strcmp(reason, "pce"))
+        return REASON_PCE;
+    if (!strcmp(reason, "auto-bandwidth"))
+        return REASON_AUTO_BANDWIDTH;
+    if (!strcmp(reason, "TED"))
+        return REASON_TED;
+    // Congestion notifications carry the full path of the reporting monitor
+    if (strchr(reason, '.'))
+        return REASON_CONGESTION;
+    return REASON_OTHER;
+}
+
+const char *FlightRecorder::getEventName(uint8_t event)
+{
+    static const char *names[NUM_EVENTS] = { "SWITCH", "PENDING_SETUP", "PENDING_LABEL", "PATH_FAILURE", "PATH_RESTORED", "NO_ALTERNATE", "RESIZE" };
+    return event < NUM_EVENTS ? names[event] : "?";
+}
+
+const char *FlightRecorder::getReasonName(uint8_t reason)
+{
+    static const char *names[NUM_REASONS] = { "other", "path_notify", "scenario", "congestion", "delayed_restoration", "pce", "auto_bandwidth", "ted" };
+    return reason < NUM_REASONS ? names[reason] : "?";
+}
+
+} // namespace insotu
@@ -0,0 +1,120 @@
+#ifndef __INSOTU_FLIGHTRECORDER_H
+#define __INSOTU_FLIGHTRECORDER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace insotu {
+
+/**
+ * Binary flight recorder for path switching decisions
+ *
+ * Keeps the most recent decisions in a fixed-size ring buffer of compact
+ * records, so the audit trail survives with text logging turned off.
+ * The buffer is written to a file on demand or at finish() and decoded
+ * with tools/flightrec_decode. Independent of OMNeT++ so that the decoder
+ * can be built standalone: times are raw simtime values, and the simtime
+ * scale exponent is stored in the file header.
+ *
+ * File layout (host byte order): Header, then Header::count records,
+ * oldest first.
+ */
+class FlightRecorder
+{
+  public:
+    enum Event : uint8_t {
+        EVENT_SWITCH = 0,           // FECs rebound from fromIndex to toIndex
+        EVENT_PENDING_SETUP,        // target LSP has no PSB, setup requested
+        EVENT_PENDING_LABEL,        // target LSP has no label yet
+        EVENT_PATH_FAILURE,         // LSP failed, toIndex = failed index
+        EVENT_PATH_RESTORED,        // LSP (re-)established, toIndex = its index
+        EVENT_NO_ALTERNATE,         // failover found no usable path
+        EVENT_RESIZE,               // LSP at toIndex replaced make-before-break (auto-bandwidth)
+        NUM_EVENTS
+    };
+
+    enum Reason : uint8_t {
+        REASON_OTHER = 0,
+        REASON_PATH_NOTIFY,
+        REASON_SCENARIO,
+        REASON_CONGESTION,
+        REASON_DELAYED_RESTORATION,
+        REASON_PCE,
+        REASON_AUTO_BANDWIDTH,
+        REASON_TED,
+        NUM_REASONS
+    };
+
+    struct Record {
+        int64_t time;               // raw simtime
+        int32_t tunnelId;
+        int32_t lspId;
+        int32_t label;              // -1 if none
+        int16_t fromIndex;
+        int16_t toIndex;
+        uint8_t event;
+        uint8_t reason;
+        uint16_t reserved;
+        uint32_t sequence;          // position in the full decision sequence
+    };
+    static_assert(sizeof(Record) == 32, "FlightRecorder::Record must stay 32 bytes");
+
+    struct Header {
+        char magic[4];              // "FLRC"
+        uint16_t version;
+        uint16_t recordSize;
+        int32_t scaleExp;           // simtime scale exponent
+        uint32_t count;             // records in this file
+        uint64_t total;             // decisions recorded, including overwritten ones
+    };
+
+    static const uint16_t VERSION = 1;
+
+  protected:
+    std::vector<Record> buffer;
+    size_t next = 0;
+    uint64_t total = 0;
+
+  public:
+    explicit FlightRecorder(size_t capacity = 0) { setCapacity(capacity); }
+
+    void setCapacity(size_t capacity);
+    size_t getCapacity() const { return buffer.size(); }
+    size_t getCount() const { return total < buffer.size() ? (size_t)total : buffer.size(); }
+    uint64_t getTotal() const { return total; }
+
+    void record(int64_t time, int tunnelId, int lspId, int label, int fromIndex, int toIndex, Event event, Reason reason)
+    {
+        if (buffer.empty())
+            return;
+        Record& r = buffer[next];
+        r.time = time;
+        r.tunnelId = tunnelId;
+        r.lspId = lspId;
+        r.label = label;
+        r.fromIndex = (int16_t)fromIndex;
+        r.toIndex = (int16_t)toIndex;
+        r.event = event;
+        r.reason = reason;
+        r.reserved = 0;
+        r.sequence = (uint32_t)total;
+        if (++next == buffer.size())
+            next = 0;
+        total++;
+    }
+
+    // Writes the buffer to a file; returns false on I/O error
+    bool dump(const char *filename, int scaleExp) const;
+
+    // Reads a dump and prints one line per record; returns false on format error
+    static bool decode(const char *filename, std::ostream& out);
+
+    static Reason classifyReason(const char *reason);
+    static const char *getEventName(uint8_t event);
+    static const char *getReasonName(uint8_t reason);
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,202 @@
+#include "FluidLinkLoad.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace insotu {
+
+Define_Module(FluidLinkLoad);
+
+void FluidLinkLoad::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled").boolValue();
+        if (!enabled)
+            return;
+
+        bufferSize = par("bufferSize").doubleValue();
+        minResidualFraction = par("minResidualFraction").doubleValue();
+        if (minResidualFraction <= 0 || minResidualFraction > 1)
+            throw cRuntimeError("minResidualFraction must be in (0, 1]");
+
+        const char *modulePath = par("srcModule");
+        cModule *module = getModuleByPath(modulePath);
+        if (!module)
+            throw cRuntimeError("Module '%s' not found", modulePath);
+        cGate *gate = module->gate(par("srcGate").stringValue());
+        channel = dynamic_cast<cDatarateChannel *>(gate->getChannel());
+        if (!channel)
+            throw cRuntimeError("Gate '%s' of '%s' has no datarate channel", gate->getFullName(), modulePath);
+
+        readProfile(par("profile").xmlValue());
+
+        stepTimer = new cMessage("fluidRateStep");
+        drainTimer = new cMessage("fluidDrain");
+        fluidRateSignal = registerSignal("fluidRate");
+        fluidBacklogSignal = registerSignal("fluidBacklog");
+
+        WATCH(rate);
+        WATCH(backlog);
+        WATCH(servedBytes);
+        WATCH(droppedBytes);
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (!enabled)
+            return;
+
+        capacity = channel->getDatarate();
+        lastUpdate = simTime();
+        channel->subscribe(POST_MODEL_CHANGE, this);
+        if (!profile.empty())
+            scheduleAt(std::max(simTime(), profile[0].time), stepTimer);
+    }
+}
+
+void FluidLinkLoad::readProfile(const cXMLElement *config)
+{
+    profile.clear();
+    for (cXMLElement *elem : config->getChildrenByTagName("rate")) {
+        const char *t = elem->getAttribute("t");
+        const char *value = elem->getAttribute("value");
+        if (!t || !value)
+            throw cRuntimeError("Fluid rate entry requires 't' and 'value' attributes at %s", elem->getSourceLocation());
+
+        RateStep step;
+        step.time = SimTime::parse(t);
+        step.rate = cValue::parseQuantity(value, "bps");
+        if (!profile.empty() && step.time < profile.back().time)
+            throw cRuntimeError("Fluid rate profile must be sorted by time at %s", elem->getSourceLocation());
+        profile.push_back(step);
+    }
+}
+
+void FluidLinkLoad::handleMessage(cMessage *msg)
+{
+    advance(simTime());
+
+    if (msg == stepTimer) {
+        rate = profile[nextStep++].rate;
+        EV_INFO << "Fluid background rate now " << rate << "bps on " << channel->getFullPath() << endl;
+        emit(fluidRateSignal, rate);
+        if (nextStep < profile.size())
+            scheduleAt(profile[nextStep].time, stepTimer);
+    }
+    else if (msg == drainTimer) {
+        // Drained by definition; clears what rounding to simtime resolution leaves over
+        servedBytes += backlog;
+        backlog = 0;
+    }
+    else
+        throw cRuntimeError("Unexpected message '%s'", msg->getName());
+
+    emit(fluidBacklogSignal, backlog);
+    applyResidualCapacity();
+    scheduleDrain();
+}
+
+void FluidLinkLoad::advance(simtime_t now)
+{
+    double dt = (now - lastUpdate).dbl();
+    if (dt <= 0)
+        return;
+    lastUpdate = now;
+
+    // Rate is constant since lastUpdate: backlog changes linearly, clamped at 0 and bufferSize
+    double arrived = rate * dt / 8;
+    double net = backlog + arrived - capacity * dt / 8;
+    double dropped = std::max(0.0, net - bufferSize);
+    double newBacklog = std::min(std::max(net, 0.0), bufferSize);
+    droppedBytes += dropped;
+    servedBytes += arrived - dropped - (newBacklog - backlog);
+    backlog = newBacklog;
+}
+
+void FluidLinkLoad::applyResidualCapacity()
+{
+    double residual = backlog > 0 ? 0 : capacity - rate;
+    residual = std::max(residual, capacity * minResidualFraction);
+    if (residual == lastSetDatarate)
+        return;
+
+    // Set first: the change notification must recognise it as our own
+    lastSetDatarate = residual;
+    channel->setDatarate(residual);
+    EV_DETAIL << "Residual capacity for packets: " << residual << "bps" << endl;
+}
+
+void FluidLinkLoad::scheduleDrain()
+{
+    // The backlog empties at capacity - rate; afterwards packets get the residual capacity
+    cancelEvent(drainTimer);
+    if (backlog > 0 && rate < capacity) {
+        // Rounded up to the simtime resolution, so the timer never fires with zero delay
+        double drainTime = backlog * 8 / (capacity - rate);
+        simtime_t delay = drainTime;
+        if (delay.dbl() < drainTime)
+            delay += SimTime::fromRaw(1);
+        scheduleAt(simTime() + delay, drainTimer);
+    }
+}
+
+void FluidLinkLoad::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    auto notification = dynamic_cast<cPostParameterChangeNotification *>(obj);
+    if (signalID == POST_MODEL_CHANGE && source == channel && notification && !strcmp(notification->par->getName(), "datarate"))
+        syncCapacity();
+}
+
+void FluidLinkLoad::syncCapacity()
+{
+    if (!enabled || !channel || capacity <= 0)
+        return;
+
+    // Any datarate other than the one set here came from outside (scenario, DatarateController)
+    double datarate = channel->getDatarate();
+    if (datarate == (lastSetDatarate >= 0 ? lastSetDatarate : capacity))
+        return;
+
+    Enter_Method_Silent("syncCapacity");
+    advance(simTime());     // with the old capacity up to now
+    EV_INFO << "Fluid link capacity " << capacity << " -> " << datarate << "bps on " << channel->getFullPath() << endl;
+    capacity = datarate;
+    applyResidualCapacity();
+    scheduleDrain();
+}
+
+double FluidLinkLoad::getServedBytes()
+{
+    advance(simTime());
+    return servedBytes;
+}
+
+double FluidLinkLoad::getBacklogBytes()
+{
+    advance(simTime());
+    return backlog;
+}
+
+double FluidLinkLoad::getDroppedBytes()
+{
+    advance(simTime());
+    return droppedBytes;
+}
+
+void FluidLinkLoad::finish()
+{
+    if (enabled) {
+        advance(simTime());
+        recordScalar("fluidServedBytes", servedBytes);
+        recordScalar("fluidDroppedBytes", droppedBytes);
+    }
+
+    if (channel && enabled)
+        channel->unsubscribe(POST_MODEL_CHANGE, this);
+    cancelAndDelete(stepTimer);
+    stepTimer = nullptr;
+    cancelAndDelete(drainTimer);
+    drainTimer = nullptr;
+}
+
+} // namespace insotu
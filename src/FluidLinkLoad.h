@@ -0,0 +1,92 @@
+#ifndef __INSOTU_FLUIDLINKLOAD_H
+#define __INSOTU_FLUIDLINKLOAD_H
+
+#include <vector>
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+
+using namespace omnetpp;
+
+namespace insotu {
+
+/**
+ * Fluid background load on one link
+ *
+ * Background traffic is a piecewise-constant rate profile instead of
+ * packets. Its queue is modelled analytically as a fluid queue
+ * (backlog grows at rate - capacity, bounded by bufferSize, and drains at
+ * capacity - rate), so the cost is one event per rate change and per
+ * drain instead of one per packet. Packetized foreground flows see the
+ * residual capacity: the link's channel datarate is set to capacity minus
+ * the fluid rate, or to minResidualFraction of it while a fluid backlog
+ * is queued ahead of them.
+ *
+ * Monitors referencing this module add the fluid bytes served and the
+ * fluid backlog to their packet measurements.
+ *
+ * A datarate set on the channel from outside (scenario, DatarateController)
+ * is taken as the new nominal capacity as soon as the channel reports the
+ * change (POST_MODEL_CHANGE); the fluid state is advanced with the old one
+ * up to that moment.
+ */
+class FluidLinkLoad : public cSimpleModule, public cListener
+{
+  protected:
+    struct RateStep {
+        simtime_t time;
+        double rate;                    // bps
+    };
+
+    // Parameters
+    bool enabled = true;
+    double bufferSize = 0;              // bytes
+    double minResidualFraction = 0;
+    std::vector<RateStep> profile;
+    size_t nextStep = 0;
+
+    // Channel
+    cDatarateChannel *channel = nullptr;
+    double capacity = 0;                // bps, nominal link capacity
+    double lastSetDatarate = -1;
+
+    // Fluid state (valid at lastUpdate)
+    double rate = 0;
+    double backlog = 0;                 // bytes
+    double servedBytes = 0;
+    double droppedBytes = 0;
+    simtime_t lastUpdate;
+
+    cMessage *stepTimer = nullptr;
+    cMessage *drainTimer = nullptr;
+
+    simsignal_t fluidRateSignal;
+    simsignal_t fluidBacklogSignal;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
+
+    void readProfile(const cXMLElement *config);
+    void advance(simtime_t now);
+    void applyResidualCapacity();
+    void scheduleDrain();
+
+  public:
+    // State advanced to the current simulation time
+    double getFluidRate() const { return rate; }
+    // Nominal capacity; the channel datarate until initialization has read it
+    double getCapacity() const { return capacity > 0 ? capacity : channel ? channel->getDatarate() : 0; }
+    // Takes a datarate set on the channel from outside as the new capacity;
+    // listeners of the same change call it before getCapacity()
+    void syncCapacity();
+    double getServedBytes();
+    double getBacklogBytes();
+    double getDroppedBytes();
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __INSOTU_LABELCOUNTERS_H
+#define __INSOTU_LABELCOUNTERS_H
+
+#include <cstdint>
+#include <vector>
+
+namespace insotu {
+
+/**
+ * Per-label packet/byte counters of the MPLS forwarding path
+ *
+ * Indexed directly by the LIB in-label of the router, so counting a packet
+ * is a bounds check and two increments. In-labels are allocated densely
+ * from a small range by LibTable, which keeps the array compact.
+ */
+class LabelCounters
+{
+  public:
+    struct Counter {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+    };
+
+  protected:
+    std::vector<Counter> counters;
+
+  public:
+    void count(int inLabel, int64_t bytes)
+    {
+        if (inLabel < 0)
+            return;
+        if ((size_t)inLabel >= counters.size())
+            counters.resize(inLabel + 1);
+        Counter& counter = counters[inLabel];
+        counter.packets++;
+        counter.bytes += bytes;
+    }
+
+    // Returns an all-zero counter for labels that never carried traffic
+    const Counter& get(int inLabel) const
+    {
+        static const Counter empty;
+        if (inLabel < 0 || (size_t)inLabel >= counters.size())
+            return empty;
+        return counters[inLabel];
+    }
+
+    size_t size() const { return counters.size(); }
+};
+
+} // namespace insotu
+
+#endif
@@ -1,7 +1,11 @@
 #include "LinkUtilizationMonitor.h"
+#include "DatarateController.h"
+#include "FluidLinkLoad.h"
 #include "RsvpTeScriptable.h"
 #include "inet/common/ModuleAccess.h"
 #include "inet/common/packet/Packet.h"
+#include "inet/networklayer/common/NetworkInterface.h"
+#include <algorithm>
 #include <omnetpp.h>
 
 namespace insotu {
@@ -21,11 +25,16 @@ void LinkUtilizationMonitor::initialize(int stage)
             return;
 
         linkCapacity = par("linkCapacity").doubleValue();
+        autoCapacity = par("autoCapacity").boolValue();
         utilizationThreshold = par("utilizationThreshold").doubleValue();
         lowThreshold = par("lowThreshold").doubleValue();
         checkInterval = par("checkInterval").doubleValue();
         measurementWindow = par("measurementWindow").doubleValue();
         tunnelId = par("tunnelId").intValue();
+        predictiveMode = par("predictiveMode").boolValue();
+        forecastAlpha = par("forecastAlpha").doubleValue();
+        forecastBeta = par("forecastBeta").doubleValue();
+        forecastHorizon = par("forecastHorizon").doubleValue();
 
         // パラメータ検証
         if (utilizationThreshold <= lowThreshold)
@@ -34,6 +43,15 @@ void LinkUtilizationMonitor::initialize(int stage)
             throw cRuntimeError("utilizationThreshold must be between 0.0 and 1.0");
         if (lowThreshold < 0.0 || lowThreshold > 1.0)
             throw cRuntimeError("lowThreshold must be between 0.0 and 1.0");
+        if (forecastAlpha <= 0.0 || forecastAlpha > 1.0 || forecastBeta <= 0.0 || forecastBeta > 1.0)
+            throw cRuntimeError("forecastAlpha and forecastBeta must be in (0.0, 1.0]");
+
+        // 適応的サンプリング（測定窓内に2点以上残るよう最大間隔は窓幅未満）
+        double minInterval = par("minCheckInterval").doubleValue();
+        double maxInterval = par("maxCheckInterval").doubleValue();
+        sampling.configure(par("adaptiveSampling").boolValue(), minInterval, maxInterval);
+        if (sampling.isEnabled() && (minInterval <= 0.0 || minInterval > maxInterval || maxInterval >= measurementWindow.dbl()))
+            throw cRuntimeError("Adaptive sampling requires 0 < minCheckInterval <= maxCheckInterval < measurementWindow");
 
         // RSVPモジュール参照
         const char *rsvpPath = par("rsvpModule");
@@ -42,21 +60,60 @@ void LinkUtilizationMonitor::initialize(int stage)
         if (!rsvp)
             throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
 
+        // 流体背景負荷モジュール参照（オプション）
+        const char *fluidPath = par("fluidModule");
+        if (fluidPath && *fluidPath) {
+            fluid = dynamic_cast<insotu::FluidLinkLoad *>(getModuleByPath(fluidPath));
+            if (!fluid)
+                throw cRuntimeError("Fluid module '%s' is not an insotu FluidLinkLoad", fluidPath);
+        }
+
+        reliefPlanning = par("reliefPlanning").boolValue();
+
         // タイマー作成
         timer = new cMessage("measureUtilization");
 
         // 統計シグナル登録
         utilizationSignal = registerSignal("linkUtilization");
-        utilizationVector.setName("Link Utilization");
+        forecastSignal = registerSignal("forecastUtilization");
+        tunnelRateSignal = registerSignal("tunnelRate");
+        tunnelShareSignal = registerSignal("tunnelShare");
+        linkCapacitySignal = registerSignal("linkCapacity");
+        utilizationVector.reset(new DeadbandVector(this, "Link Utilization"));
 
+        WATCH(linkCapacity);
         WATCH(currentUtilization);
+        WATCH(forecastUtilization);
         WATCH(overThreshold);
+        WATCH(tunnelRate);
+        WATCH(tunnelShare);
         WATCH(totalBytesTransmitted);
     }
     else if (stage == inet::INITSTAGE_LAST) {
         if (enabled && timer) {
             // キューシグナルをサブスクライブ
             subscribeToQueueSignals();
+            emit(linkCapacitySignal, linkCapacity);
+            if (autoCapacity)
+                subscribeToCapacityChanges();
+            if (linkCapacity <= 0)
+                throw cRuntimeError("linkCapacity must be positive");
+
+            // 監視インターフェース（インターフェースIDはインターフェーステーブル登録後に確定）
+            auto networkInterface = dynamic_cast<inet::NetworkInterface *>(findInterfaceModule());
+            if (networkInterface)
+                interfaceId = networkInterface->getInterfaceId();
+            else if (reliefPlanning)
+                throw cRuntimeError("reliefPlanning requires interfaceModule to be a network interface, got '%s'", par("interfaceModule").stringValue());
+            else
+                EV_WARN << "No network interface found, tunnel share counts all LSPs of tunnel " << tunnelId << endl;
+
+            // トンネル寄与率の基準値
+            lastTunnelBytes = rsvp->getTunnelBytes(tunnelId, interfaceId);
+            lastLinkBytes = getBytesTransmitted();
+            lastTunnelSampleTime = simTime();
+            if (reliefPlanning)
+                updateReliefRates();
 
             // 初期測定
             scheduleAt(simTime() + checkInterval, timer);
@@ -82,8 +139,79 @@ void LinkUtilizationMonitor::subscribeToQueueSignals()
     EV_INFO << "Subscribed to popPacket signal from " << queueModule->getFullPath() << endl;
 }
 
+cModule *LinkUtilizationMonitor::findInterfaceModule()
+{
+    // interfaceModule、なければキューの親（PPPインターフェース）
+    const char *interfacePath = par("interfaceModule");
+    const char *queuePath = par("queueModule");
+    cModule *interfaceModule = interfacePath && *interfacePath ? getModuleByPath(interfacePath) : nullptr;
+    if (!interfaceModule && queuePath && *queuePath) {
+        cModule *queueModule = getModuleByPath(queuePath);
+        interfaceModule = queueModule ? queueModule->getParentModule() : nullptr;
+    }
+    return interfaceModule;
+}
+
+void LinkUtilizationMonitor::subscribeToCapacityChanges()
+{
+    // 送信チャネル: 監視インターフェースの phys$o から辿る
+    cModule *interfaceModule = findInterfaceModule();
+    if (interfaceModule && interfaceModule->hasGate("phys$o"))
+        txChannel = interfaceModule->gate("phys$o")->findTransmissionChannel();
+
+    if (txChannel) {
+        // datarate の変更は POST_MODEL_CHANGE としてチャネル自身から通知される
+        txChannel->subscribe(POST_MODEL_CHANGE, this);
+        setLinkCapacity(fluid ? fluid->getCapacity() : txChannel->getNominalDatarate(), txChannel->getFullPath().c_str());
+    }
+    else
+        EV_WARN << "No transmission channel found for " << (interfaceModule ? interfaceModule->getFullPath() : std::string("<none>"))
+                << ", using linkCapacity " << linkCapacity << " bps" << endl;
+
+    // DatarateController（オプション）
+    const char *controllerPath = par("datarateModule");
+    if (controllerPath && *controllerPath) {
+        datarateController = dynamic_cast<insotu::DatarateController *>(getModuleByPath(controllerPath));
+        if (!datarateController)
+            throw cRuntimeError("Datarate module '%s' is not an insotu DatarateController", controllerPath);
+        datarateChangedSignal = registerSignal("datarateChanged");
+        datarateController->subscribe(datarateChangedSignal, this);
+        setLinkCapacity(datarateController->getCurrentDatarate(), datarateController->getFullPath().c_str());
+    }
+}
+
+void LinkUtilizationMonitor::setLinkCapacity(double capacity, const char *reason)
+{
+    // 0（無制限）などの無効値は無視して直前の容量を保つ
+    if (capacity <= 0 || capacity == linkCapacity)
+        return;
+
+    EV_INFO << "Link capacity " << linkCapacity << " -> " << capacity << " bps (" << reason << ")" << endl;
+    linkCapacity = capacity;
+    emit(linkCapacitySignal, linkCapacity);
+}
+
+void LinkUtilizationMonitor::receiveSignal(cComponent *source, simsignal_t signalID, double value, cObject *details)
+{
+    if (signalID == datarateChangedSignal && source == datarateController)
+        setLinkCapacity(value, "datarateChanged");
+}
+
 void LinkUtilizationMonitor::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
 {
+    // 送信チャネルの datarate 変更
+    // （流体背景負荷がある場合、チャネルは残余容量に設定されるため公称容量を使う。
+    //  リスナーの呼び出し順に依らないよう、先に FluidLinkLoad に変更を反映させる）
+    if (signalID == POST_MODEL_CHANGE) {
+        auto notification = dynamic_cast<cPostParameterChangeNotification *>(obj);
+        if (source == txChannel && notification && !strcmp(notification->par->getName(), "datarate")) {
+            if (fluid)
+                fluid->syncCapacity();
+            setLinkCapacity(fluid ? fluid->getCapacity() : notification->par->doubleValue(), "channel datarate");
+        }
+        return;
+    }
+
     // パケットがキューから出た（送信された）
     if (signalID == popPacketSignal) {
         Packet *packet = dynamic_cast<Packet *>(obj);
@@ -101,7 +229,7 @@ void LinkUtilizationMonitor::handleMessage(cMessage *msg)
 {
     if (msg == timer) {
         measureUtilization();
-        scheduleAt(simTime() + checkInterval, timer);
+        scheduleAt(simTime() + sampling.nextInterval(checkInterval.dbl()), timer);
     }
     else {
         delete msg;
@@ -118,6 +246,14 @@ void LinkUtilizationMonitor::finish()
             queueModule->unsubscribe(popPacketSignal, this);
         }
     }
+    if (txChannel)
+        txChannel->unsubscribe(POST_MODEL_CHANGE, this);
+    if (datarateController)
+        datarateController->unsubscribe(datarateChangedSignal, this);
+
+    // 間引きで保留中のサンプルを書き出す
+    if (utilizationVector)
+        utilizationVector->flush();
 
     cancelAndDelete(timer);
     timer = nullptr;
@@ -133,22 +269,42 @@ void LinkUtilizationMonitor::measureUtilization()
 
     // 統計記録
     emit(utilizationSignal, currentUtilization);
-    utilizationVector.record(currentUtilization);
+    utilizationVector->record(currentUtilization);
 
-    EV_INFO << "Link utilization: " << (currentUtilization * 100.0) << "%" << endl;
+    // トンネルの実トラフィックによる寄与率
+    updateTunnelShare();
+    if (reliefPlanning)
+        updateReliefRates();
 
-    // 閾値判定
-    if (!overThreshold && currentUtilization >= utilizationThreshold) {
+    EV_INFO << "Link utilization: " << (currentUtilization * 100.0) << "%, tunnel " << tunnelId
+            << " share: " << (tunnelShare * 100.0) << "%" << endl;
+
+    // 予測値の更新
+    forecastUtilization = updateForecast(currentUtilization);
+    if (predictiveMode)
+        emit(forecastSignal, forecastUtilization);
+
+    // 閾値判定（予測モードでは先読み時間内に閾値へ達する予測でも切り替える）
+    bool exceeded = currentUtilization >= utilizationThreshold;
+    bool forecastExceeded = predictiveMode && forecastUtilization >= utilizationThreshold;
+
+    if (!overThreshold && (exceeded || forecastExceeded)) {
         // 閾値超過 → 代替パスへ切り替え
         overThreshold = true;
-        EV_WARN << "Link utilization exceeded threshold ("
-                << (currentUtilization * 100.0) << "% >= "
-                << (utilizationThreshold * 100.0) << "%), switching to backup path for tunnel "
-                << tunnelId << endl;
-
-        rsvp->handleCongestionNotification(tunnelId, true, getFullPath().c_str());
+        if (exceeded)
+            EV_WARN << "Link utilization exceeded threshold ("
+                    << (currentUtilization * 100.0) << "% >= "
+                    << (utilizationThreshold * 100.0) << "%), switching to backup path for tunnel "
+                    << tunnelId << " (tunnel rate " << tunnelRate << "bps)" << endl;
+        else
+            EV_WARN << "Link utilization forecast to exceed threshold within " << forecastHorizon << "s ("
+                    << (forecastUtilization * 100.0) << "% >= "
+                    << (utilizationThreshold * 100.0) << "%), switching to backup path for tunnel "
+                    << tunnelId << " (tunnel rate " << tunnelRate << "bps)" << endl;
+
+        notifyCongestion(true, std::max(currentUtilization, forecastExceeded ? forecastUtilization : 0.0));
     }
-    else if (overThreshold && currentUtilization <= lowThreshold) {
+    else if (overThreshold && currentUtilization <= lowThreshold && !forecastExceeded) {
         // 閾値以下に回復 → プライマリパスへ復帰可能
         overThreshold = false;
         EV_INFO << "Link utilization recovered ("
@@ -156,10 +312,115 @@ void LinkUtilizationMonitor::measureUtilization()
                 << (lowThreshold * 100.0) << "%), can restore primary path for tunnel "
                 << tunnelId << endl;
 
-        rsvp->handleCongestionNotification(tunnelId, false, getFullPath().c_str());
+        notifyCongestion(false, currentUtilization);
+    }
+
+    // 次の測定間隔: 次に越えうる閾値までの距離（予測モードでは予測値も考慮）
+    sampling.reset();
+    double span = utilizationThreshold - lowThreshold;
+    if (overThreshold)
+        sampling.note(currentUtilization, lowThreshold, span);
+    else {
+        sampling.note(currentUtilization, utilizationThreshold, span);
+        if (predictiveMode)
+            sampling.note(forecastUtilization, utilizationThreshold, span);
     }
 }
 
+void LinkUtilizationMonitor::notifyCongestion(bool congested, double utilization)
+{
+    if (!reliefPlanning) {
+        rsvp->handleCongestionNotification(tunnelId, congested, getFullPath().c_str());
+        return;
+    }
+
+    if (congested) {
+        // lowThreshold まで下げるのに必要な最少数のトンネルだけを切り替える
+        double excessRate = (utilization - lowThreshold) * linkCapacity;
+        relievedTunnels = rsvp->planCongestionRelief(interfaceId, reliefRates, excessRate);
+        for (int relievedTunnelId : relievedTunnels)
+            rsvp->handleCongestionNotification(relievedTunnelId, true, getFullPath().c_str());
+    }
+    else {
+        // 緩和のため切り替えたトンネルのみ復帰可能にする
+        for (int relievedTunnelId : relievedTunnels)
+            rsvp->handleCongestionNotification(relievedTunnelId, false, getFullPath().c_str());
+        relievedTunnels.clear();
+    }
+}
+
+void LinkUtilizationMonitor::updateReliefRates()
+{
+    simtime_t now = simTime();
+    double dt = (now - reliefSampleTime).dbl();
+
+    // 全トンネルの実測レート（ラベル別カウンタの差分）
+    for (const auto& elem : rsvp->getTunnelLspOrder()) {
+        uint64_t bytes = rsvp->getTunnelBytes(elem.first, interfaceId);
+        auto it = reliefLastBytes.find(elem.first);
+        if (it != reliefLastBytes.end() && dt > 0.0) {
+            uint64_t bytesDiff = bytes >= it->second ? bytes - it->second : bytes;
+            reliefRates[elem.first] = bytesDiff * 8.0 / dt;
+        }
+        reliefLastBytes[elem.first] = bytes;
+    }
+    reliefSampleTime = now;
+}
+
+void LinkUtilizationMonitor::updateTunnelShare()
+{
+    simtime_t now = simTime();
+    double dt = (now - lastTunnelSampleTime).dbl();
+    if (dt <= 0.0)
+        return;
+
+    // このインターフェースを出るLSPのみ数える
+    // LSP再シグナリングでラベルが変わるとカウンタ合計が減ることがある
+    uint64_t tunnelBytes = rsvp->getTunnelBytes(tunnelId, interfaceId);
+    uint64_t bytesDiff = tunnelBytes >= lastTunnelBytes ? tunnelBytes - lastTunnelBytes : tunnelBytes;
+    lastTunnelBytes = tunnelBytes;
+
+    // リンク送信レートもトンネルと同じ区間で求める（測定窓の使用率は使わない）
+    int64_t linkBytes = getBytesTransmitted();
+    int64_t linkDiff = linkBytes >= lastLinkBytes ? linkBytes - lastLinkBytes : linkBytes;
+    lastLinkBytes = linkBytes;
+    lastTunnelSampleTime = now;
+
+    tunnelRate = bytesDiff * 8.0 / dt;
+    double linkRate = linkDiff * 8.0 / dt;
+    tunnelShare = linkRate > 0.0 ? std::min(1.0, tunnelRate / linkRate) : 0.0;
+
+    emit(tunnelRateSignal, tunnelRate);
+    emit(tunnelShareSignal, tunnelShare);
+}
+
+double LinkUtilizationMonitor::updateForecast(double utilization)
+{
+    simtime_t now = simTime();
+
+    if (!forecastInitialized) {
+        forecastLevel = utilization;
+        forecastTrend = 0.0;
+        lastForecastTime = now;
+        forecastInitialized = true;
+        return std::min(1.0, std::max(0.0, utilization));
+    }
+
+    double dt = (now - lastForecastTime).dbl();
+    if (dt > 0.0) {
+        lastForecastTime = now;
+
+        // Holt法: レベルとトレンド（1秒あたり）を指数平滑化
+        double previousLevel = forecastLevel;
+        forecastLevel = forecastAlpha * utilization + (1.0 - forecastAlpha) * (previousLevel + forecastTrend * dt);
+        forecastTrend = forecastBeta * (forecastLevel - previousLevel) / dt + (1.0 - forecastBeta) * forecastTrend;
+    }
+
+    // 先読み時間後の使用率を予測（どの経路でも [0, 1] に制限）
+    double forecast = forecastLevel + forecastTrend * forecastHorizon.dbl();
+    return std::min(1.0, std::max(0.0, forecast));
+}
+
 double LinkUtilizationMonitor::calculateUtilization()
 {
     // 現在の送信バイト数を取得
@@ -208,7 +469,9 @@ double LinkUtilizationMonitor::calculateUtilization()
 
 int64_t LinkUtilizationMonitor::getBytesTransmitted()
 {
-    // receiveSignal()で累積している送信バイト数を返す
+    // receiveSignal()で累積している送信バイト数を返す（流体背景負荷分を加算）
+    if (fluid)
+        return totalBytesTransmitted + (int64_t)fluid->getServedBytes();
     return totalBytesTransmitted;
 }
 
@@ -1,9 +1,15 @@
 #ifndef __INSOTU_LINKUTILIZATIONMONITOR_H
 #define __INSOTU_LINKUTILIZATIONMONITOR_H
 
+#include <map>
+#include <memory>
+#include <vector>
 #include <omnetpp.h>
 #include "inet/common/InitStages.h"
 
+#include "AdaptiveSampling.h"
+#include "DeadbandVector.h"
+
 using namespace omnetpp;
 
 namespace inet {
@@ -17,6 +23,8 @@ class PacketEventTag;
 
 namespace insotu {
 
+class DatarateController;
+class FluidLinkLoad;
 class RsvpTeScriptable;
 
 /**
@@ -28,11 +36,30 @@ class RsvpTeScriptable;
  * - 閾値を超えた場合、RSVP-TEに通知して代替パスへ切り替え
  *
  * パラメータ:
- * - linkCapacity: リンク容量（bps）
+ * - linkCapacity: リンク容量（bps）、autoCapacity で容量が得られない場合の値
+ * - autoCapacity: 送信チャネルの datarate を容量とし、その変更に追従する
  * - utilizationThreshold: 使用率閾値（0.0-1.0、例: 0.8 = 80%）
  * - lowThreshold: 復帰閾値（0.0-1.0、例: 0.5 = 50%）
  * - checkInterval: チェック間隔（秒）
  * - measurementWindow: 測定窓幅（秒）
+ * - predictiveMode: Holt法（トレンド付き指数平滑）による予測で切り替えるか
+ * - forecastHorizon: 予測の先読み時間（秒）
+ * - adaptiveSampling: 閾値までの距離に応じて測定間隔を min/maxCheckInterval の間で変える
+ *
+ * トンネル寄与率: 入口ルータのラベル別カウンタ（RsvpTeScriptable::getTunnelBytes）
+ * から、このインターフェースを出るLSPだけの実送信レートを求め、同じ区間の
+ * リンク送信レートに占める割合を記録する
+ *
+ * 緩和計画（reliefPlanning）: 閾値超過時に tunnelId のトンネルだけでなく、
+ * このインターフェースを通る全トンネルの実測レートから、lowThreshold 以下に
+ * 戻すのに必要な最少数のトンネルを RSVP-TE に選ばせて、それらだけを切り替える
+ *
+ * 容量の追従: 送信チャネルの datarate パラメータ変更（POST_MODEL_CHANGE）と
+ * datarateModule（DatarateController）の datarateChanged を購読し、
+ * 変化したときだけ linkCapacity を更新する（測定ごとの参照はしない）
+ *
+ * 流体背景負荷: fluidModule（FluidLinkLoad）が指定されていれば、
+ * その流体トラフィックの送信バイト数をパケット分に加算して使用率を求める
  */
 class LinkUtilizationMonitor : public cSimpleModule, public cListener
 {
@@ -43,11 +70,25 @@ class LinkUtilizationMonitor : public cSimpleModule, public cListener
     double lowThreshold = 0;          // 0.0-1.0
     simtime_t checkInterval = 0;
     simtime_t measurementWindow = 0;
+    AdaptiveSampling sampling;        // 閾値付近では短い間隔で測定
     int tunnelId = -1;
     bool enabled = true;
 
+    // 容量の自動追従
+    bool autoCapacity = false;
+    cChannel *txChannel = nullptr;              // 監視対象インターフェースの送信チャネル
+    insotu::DatarateController *datarateController = nullptr;
+    simsignal_t datarateChangedSignal = -1;
+
+    // 予測モード（Holt法）
+    bool predictiveMode = false;
+    double forecastAlpha = 0;         // レベル平滑化係数
+    double forecastBeta = 0;          // トレンド平滑化係数
+    simtime_t forecastHorizon = 0;
+
     // 参照
     insotu::RsvpTeScriptable *rsvp = nullptr;
+    insotu::FluidLinkLoad *fluid = nullptr;
     cMessage *timer = nullptr;
 
     // 測定データ
@@ -64,9 +105,35 @@ class LinkUtilizationMonitor : public cSimpleModule, public cListener
     bool overThreshold = false;
     double currentUtilization = 0.0;
 
+    // 予測状態
+    bool forecastInitialized = false;
+    double forecastLevel = 0.0;
+    double forecastTrend = 0.0;       // 1秒あたりの使用率変化
+    double forecastUtilization = 0.0;
+    simtime_t lastForecastTime = 0;
+
+    // 緩和計画
+    bool reliefPlanning = false;
+    std::map<int, uint64_t> reliefLastBytes;    // トンネルID → 前回の累積バイト数
+    std::map<int, double> reliefRates;          // トンネルID → 実測レート（bps）
+    simtime_t reliefSampleTime = 0;
+    std::vector<int> relievedTunnels;           // 緩和のため切り替えたトンネル
+
+    // トンネル寄与率（ラベル別カウンタより）
+    int interfaceId = -1;             // 監視インターフェース（不明なら -1 で全LSPを数える）
+    uint64_t lastTunnelBytes = 0;
+    int64_t lastLinkBytes = 0;        // 同じ窓でリンク送信レートを求めるための基準値
+    simtime_t lastTunnelSampleTime = 0;
+    double tunnelRate = 0.0;          // bps
+    double tunnelShare = 0.0;         // リンク負荷に占めるトンネルの割合
+
     // 統計
-    cOutVector utilizationVector;
+    std::unique_ptr<DeadbandVector> utilizationVector;  // vector-deadband で間引き可
     simsignal_t utilizationSignal;
+    simsignal_t forecastSignal;
+    simsignal_t tunnelRateSignal;
+    simsignal_t tunnelShareSignal;
+    simsignal_t linkCapacitySignal;
 
   protected:
     virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
@@ -74,12 +141,20 @@ class LinkUtilizationMonitor : public cSimpleModule, public cListener
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
     virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, double value, cObject *details) override;
 
     void measureUtilization();
     double calculateUtilization();
+    double updateForecast(double utilization);
+    void updateTunnelShare();
+    void updateReliefRates();
+    void notifyCongestion(bool congested, double utilization);
     int64_t getBytesTransmitted();
     void cleanOldMeasurements();
     void subscribeToQueueSignals();
+    void subscribeToCapacityChanges();
+    cModule *findInterfaceModule();
+    void setLinkCapacity(double capacity, const char *reason);
 
   private:
     simsignal_t popPacketSignal = -1;
@@ -0,0 +1,206 @@
+#include "LspProbeGenerator.h"
+
+#include "EnhancedLinkMonitor.h"
+#include "LspProbe_m.h"
+#include "MplsScriptable.h"
+#include "RsvpTeScriptable.h"
+#include "inet/common/packet/Packet.h"
+#include <cmath>
+#include <omnetpp.h>
+
+namespace insotu {
+
+using namespace omnetpp;
+using inet::Packet;
+
+Define_Module(LspProbeGenerator);
+
+void LspProbeGenerator::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled").boolValue();
+        if (!enabled)
+            return;
+
+        probeInterval = par("probeInterval");
+        probeTimeout = par("probeTimeout");
+        if (probeInterval <= 0 || probeTimeout <= 0)
+            throw cRuntimeError("probeInterval and probeTimeout must be positive");
+
+        const char *rsvpPath = par("rsvpModule");
+        cModule *rsvpModule = rsvpPath && *rsvpPath ? getModuleByPath(rsvpPath) : nullptr;
+        rsvp = rsvpModule ? dynamic_cast<insotu::RsvpTeScriptable *>(rsvpModule) : nullptr;
+        if (!rsvp)
+            throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
+
+        const char *mplsPath = par("mplsModule");
+        cModule *mplsModule = mplsPath && *mplsPath ? getModuleByPath(mplsPath) : nullptr;
+        mpls = mplsModule ? dynamic_cast<insotu::MplsScriptable *>(mplsModule) : nullptr;
+        if (!mpls)
+            throw cRuntimeError("MPLS module '%s' is not an insotu MplsScriptable", mplsPath ? mplsPath : "<null>");
+
+        cStringTokenizer tokenizer(par("monitorModules"), " ");
+        while (const char *monitorPath = tokenizer.nextToken()) {
+            auto monitor = dynamic_cast<insotu::EnhancedLinkMonitor *>(getModuleByPath(monitorPath));
+            if (!monitor)
+                throw cRuntimeError("Monitor module '%s' is not an insotu EnhancedLinkMonitor", monitorPath);
+            // The monitor may not have read its parameters yet in this stage
+            if (!monitor->par("enabled").boolValue())
+                throw cRuntimeError("Monitor module '%s' is disabled", monitorPath);
+            tunnelMonitors[monitor->par("tunnelId").intValue()] = monitor;
+        }
+
+        probeTimer = new cMessage("probeTimer");
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (enabled && probeTimer) {
+            rsvp->setLspProbe(this);
+            scheduleAt(simTime() + par("startTime").doubleValue(), probeTimer);
+        }
+    }
+}
+
+void LspProbeGenerator::handleMessage(cMessage *msg)
+{
+    if (msg == probeTimer) {
+        sendProbes();
+        scheduleAt(simTime() + probeInterval, probeTimer);
+    }
+    else {
+        processProbeReply(msg);
+    }
+}
+
+void LspProbeGenerator::finish()
+{
+    cancelAndDelete(probeTimer);
+    probeTimer = nullptr;
+
+    for (auto& entry : lspStates) {
+        LspProbeState& state = entry.second;
+        std::string prefix = "tunnel" + std::to_string(state.tunnelId) + " lsp" + std::to_string(state.lspId);
+        recordScalar((prefix + " probesSent").c_str(), state.sent);
+        recordScalar((prefix + " probesLost").c_str(), state.lost);
+        if (state.hasDelay)
+            recordScalar((prefix + " lastDelay").c_str(), state.lastDelay);
+        state.delayVector->flush();
+        state.jitterVector->flush();
+    }
+}
+
+LspProbeGenerator::LspProbeState& LspProbeGenerator::getLspState(int tunnelId, int lspId)
+{
+    LspProbeState& state = lspStates[std::make_pair(tunnelId, lspId)];
+    if (!state.delayVector) {
+        std::string prefix = "tunnel" + std::to_string(tunnelId) + " lsp" + std::to_string(lspId);
+        state.tunnelId = tunnelId;
+        state.lspId = lspId;
+        state.delayVector.reset(new DeadbandVector(this, (prefix + " one-way delay").c_str()));
+        state.jitterVector.reset(new DeadbandVector(this, (prefix + " jitter").c_str()));
+    }
+    return state;
+}
+
+EnhancedLinkMonitor *LspProbeGenerator::findActiveMonitor(const LspProbeState& state) const
+{
+    auto it = tunnelMonitors.find(state.tunnelId);
+    if (it == tunnelMonitors.end() || rsvp->getActiveLspId(state.tunnelId) != state.lspId)
+        return nullptr;
+    return it->second;
+}
+
+void LspProbeGenerator::sendProbes()
+{
+    for (const auto& tunnel : rsvp->getTunnelLspOrder()) {
+        int tunnelId = tunnel.first;
+        for (int lspId : tunnel.second) {
+            int inLabel = rsvp->getLspInLabel(tunnelId, lspId);
+            if (inLabel < 0)
+                continue;
+
+            LspProbeState& state = getLspState(tunnelId, lspId);
+            expireOutstandingProbes(state);
+
+            auto probe = inet::makeShared<LspProbePacket>();
+            probe->setGeneratorId(getId());
+            probe->setTunnelId(tunnelId);
+            probe->setLspId(lspId);
+            probe->setSequenceNumber(state.nextSequenceNumber);
+            probe->setSendTime(simTime());
+
+            auto packet = new Packet("lspProbe", probe);
+            if (!mpls->sendLspProbe(packet, inLabel))
+                continue;
+
+            state.outstanding[state.nextSequenceNumber++] = simTime();
+            state.sent++;
+            if (auto monitor = findActiveMonitor(state))
+                monitor->reportPacketSent();
+        }
+    }
+}
+
+void LspProbeGenerator::expireOutstandingProbes(LspProbeState& state)
+{
+    simtime_t cutoff = simTime() - probeTimeout;
+    auto monitor = findActiveMonitor(state);
+
+    // Sequence numbers increase with send time, so expired probes are at the front
+    while (!state.outstanding.empty() && state.outstanding.begin()->second < cutoff) {
+        EV_DETAIL << "LSP probe " << state.outstanding.begin()->first << " of tunnel " << state.tunnelId
+                  << " LSP " << state.lspId << " lost" << endl;
+        state.outstanding.erase(state.outstanding.begin());
+        state.lost++;
+        if (monitor)
+            monitor->reportPacketDrop();
+    }
+}
+
+void LspProbeGenerator::processProbeReply(cMessage *msg)
+{
+    auto packet = check_and_cast<Packet *>(msg);
+    const auto& probe = packet->peekAtFront<LspProbePacket>();
+
+    auto it = lspStates.find(std::make_pair(probe->getTunnelId(), probe->getLspId()));
+    if (it == lspStates.end() || it->second.outstanding.erase(probe->getSequenceNumber()) == 0) {
+        EV_DETAIL << "Ignoring late or unknown LSP probe " << probe->getSequenceNumber() << endl;
+        delete packet;
+        return;
+    }
+
+    LspProbeState& state = it->second;
+    simtime_t delay = simTime() - probe->getSendTime();
+
+    // RFC 3550 interarrival jitter estimator
+    if (state.hasDelay) {
+        double d = std::fabs((delay - state.lastDelay).dbl());
+        state.jitter += (d - state.jitter) / 16.0;
+    }
+    state.lastDelay = delay;
+    state.hasDelay = true;
+    state.received++;
+
+    state.delayVector->record(delay);
+    state.jitterVector->record(state.jitter);
+
+    if (auto monitor = findActiveMonitor(state))
+        monitor->reportLatency(delay);
+
+    delete packet;
+}
+
+simtime_t LspProbeGenerator::getLspDelay(int tunnelId, int lspId) const
+{
+    auto it = lspStates.find(std::make_pair(tunnelId, lspId));
+    return it != lspStates.end() && it->second.hasDelay ? it->second.lastDelay : SIMTIME_ZERO;
+}
+
+double LspProbeGenerator::getLspJitter(int tunnelId, int lspId) const
+{
+    auto it = lspStates.find(std::make_pair(tunnelId, lspId));
+    return it != lspStates.end() ? it->second.jitter : 0.0;
+}
+
+} // namespace insotu
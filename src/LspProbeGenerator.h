@@ -0,0 +1,85 @@
+#ifndef __INSOTU_LSPPROBEGENERATOR_H
+#define __INSOTU_LSPPROBEGENERATOR_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+
+#include "DeadbandVector.h"
+
+using namespace omnetpp;
+
+namespace insotu {
+
+class EnhancedLinkMonitor;
+class MplsScriptable;
+class RsvpTeScriptable;
+
+/**
+ * LSP OAM probe generator
+ *
+ * Periodically sends small timestamped probes down every established LSP
+ * (active and backup) of the headend RSVP-TE module. The egress LER returns
+ * them (see MplsScriptable), and the generator derives per-LSP one-way
+ * delay, jitter (RFC 3550 estimator) and loss. Measurements of each
+ * tunnel's active LSP are fed into the EnhancedLinkMonitor of that tunnel
+ * through reportLatency()/reportPacketSent()/reportPacketDrop(); the
+ * per-LSP figures are available for path selection via getLspDelay().
+ */
+class LspProbeGenerator : public cSimpleModule
+{
+  protected:
+    struct LspProbeState {
+        int tunnelId = -1;
+        int lspId = -1;
+        uint32_t nextSequenceNumber = 0;
+        std::map<uint32_t, simtime_t> outstanding;  // sequence number -> send time
+
+        bool hasDelay = false;
+        simtime_t lastDelay = 0;
+        double jitter = 0;
+        long sent = 0;
+        long received = 0;
+        long lost = 0;
+
+        std::unique_ptr<DeadbandVector> delayVector;
+        std::unique_ptr<DeadbandVector> jitterVector;
+    };
+
+    // Configuration
+    simtime_t probeInterval = 0;
+    simtime_t probeTimeout = 0;
+    bool enabled = true;
+
+    // Module references
+    insotu::RsvpTeScriptable *rsvp = nullptr;
+    insotu::MplsScriptable *mpls = nullptr;
+    std::map<int, insotu::EnhancedLinkMonitor *> tunnelMonitors;
+
+    // Per-LSP state, keyed by (tunnelId, lspId)
+    std::map<std::pair<int, int>, LspProbeState> lspStates;
+
+    cMessage *probeTimer = nullptr;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    void sendProbes();
+    void processProbeReply(cMessage *msg);
+    void expireOutstandingProbes(LspProbeState& state);
+    LspProbeState& getLspState(int tunnelId, int lspId);
+    EnhancedLinkMonitor *findActiveMonitor(const LspProbeState& state) const;
+
+  public:
+    simtime_t getLspDelay(int tunnelId, int lspId) const;
+    double getLspJitter(int tunnelId, int lspId) const;
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,141 @@
+#include "MplsScriptable.h"
+
+#include "EgressSlaMonitor.h"
+#include "LspProbe_m.h"
+#include "RsvpClassifierScriptable.h"
+#include "inet/common/Protocol.h"
+#include "inet/common/ProtocolTag_m.h"
+#include "inet/common/packet/Packet.h"
+#include "inet/linklayer/common/InterfaceTag_m.h"
+#include "inet/networklayer/contract/IInterfaceTable.h"
+#include "inet/networklayer/mpls/LibTable.h"
+#include "inet/networklayer/mpls/MplsPacket_m.h"
+#include <omnetpp.h>
+
+namespace insotu {
+
+using namespace omnetpp;
+using inet::LabelOpVector;
+using inet::MplsHeader;
+using inet::Packet;
+
+Define_Module(MplsScriptable);
+
+void MplsScriptable::initialize(int stage)
+{
+    inet::Mpls::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        // Ingress packets are only labelled inside the classifier
+        if (auto classifier = dynamic_cast<RsvpClassifierScriptable *>(pct.get()))
+            classifier->setLabelCounters(&labelCounters);
+        else
+            EV_WARN << "Classifier is not an RsvpClassifierScriptable, ingress label counters disabled" << endl;
+    }
+}
+
+void MplsScriptable::processMplsPacketFromL2(Packet *packet)
+{
+    if (isOamProbeForEgress(packet)) {
+        reflectLspProbe(packet);
+        return;
+    }
+
+    int inLabel = packet->peekAtFront<MplsHeader>()->getLabel();
+    labelCounters.count(inLabel, packet->getByteLength());
+    if (slaMonitor)
+        slaMonitor->observeLspPacket(inLabel, packet);
+
+    inet::Mpls::processMplsPacketFromL2(packet);
+}
+
+bool MplsScriptable::isOamProbeForEgress(Packet *packet)
+{
+    // Data traffic carries a single label; only look deeper for stacked labels
+    const auto& topHeader = packet->peekAtFront<MplsHeader>();
+    if (topHeader->getS())
+        return false;
+
+    const auto& nextHeader = packet->peekDataAt<MplsHeader>(topHeader->getChunkLength());
+    if (nextHeader->getLabel() != OAM_ALERT_LABEL)
+        return false;
+
+    // Only the egress of the LSP pops the top label
+    auto interfaceInd = packet->findTag<inet::InterfaceInd>();
+    inet::NetworkInterface *inInterface = interfaceInd ? ift->getInterfaceById(interfaceInd->getInterfaceId()) : nullptr;
+    LabelOpVector outLabel;
+    std::string outInterface;
+    int color;
+    if (!lt->resolveLabel(inInterface ? inInterface->getInterfaceName() : "", topHeader->getLabel(), outLabel, outInterface, color))
+        return false;
+
+    return outLabel.size() == 1 && outLabel[0].optcode == POP_OPER;
+}
+
+void MplsScriptable::reflectLspProbe(Packet *packet)
+{
+    packet->popAtFront<MplsHeader>();
+    packet->popAtFront<MplsHeader>();
+
+    const auto& probe = packet->peekAtFront<LspProbePacket>();
+    cModule *generator = getSimulation()->getModule(probe->getGeneratorId());
+    if (!generator) {
+        EV_WARN << "Discarding LSP probe for tunnel " << probe->getTunnelId() << ", generator not found" << endl;
+        delete packet;
+        return;
+    }
+
+    EV_DEBUG << "Returning LSP probe " << probe->getSequenceNumber() << " of tunnel " << probe->getTunnelId()
+             << " LSP " << probe->getLspId() << " to " << generator->getFullPath() << endl;
+    packet->clearTags();
+    sendDirect(packet, generator, "probeIn");
+}
+
+bool MplsScriptable::sendLspProbe(Packet *probe, int inLabel)
+{
+    Enter_Method("sendLspProbe");
+    take(probe);
+
+    LabelOpVector outLabel;
+    std::string outInterface;
+    int color;
+    if (!lt->resolveLabel("", inLabel, outLabel, outInterface, color)) {
+        EV_WARN << "Cannot send LSP probe, label " << inLabel << " is not resolvable" << endl;
+        delete probe;
+        return false;
+    }
+
+    inet::NetworkInterface *ie = ift->findInterfaceByName(outInterface.c_str());
+    if (!ie) {
+        EV_WARN << "Cannot send LSP probe, outgoing interface " << outInterface << " not found" << endl;
+        delete probe;
+        return false;
+    }
+
+    // OAM alert label at the bottom of the stack, LSP label(s) on top
+    auto oamHeader = inet::makeShared<MplsHeader>();
+    oamHeader->setLabel(OAM_ALERT_LABEL);
+    oamHeader->setS(true);
+    oamHeader->setTtl(255);
+    probe->insertAtFront(oamHeader);
+
+    for (const auto& op : outLabel) {
+        if (op.optcode != PUSH_OPER) {
+            EV_WARN << "Cannot send LSP probe, ingress entry for label " << inLabel << " is not a push" << endl;
+            delete probe;
+            return false;
+        }
+        auto mplsHeader = inet::makeShared<MplsHeader>();
+        mplsHeader->setLabel(op.label);
+        mplsHeader->setS(false);
+        mplsHeader->setTtl(255);
+        probe->insertAtFront(mplsHeader);
+    }
+
+    probe->addTagIfAbsent<inet::InterfaceReq>()->setInterfaceId(ie->getInterfaceId());
+    probe->addTagIfAbsent<inet::PacketProtocolTag>()->setProtocol(&inet::Protocol::mpls);
+    sendToL2(probe);
+    return true;
+}
+
+} // namespace insotu
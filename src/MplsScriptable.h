@@ -0,0 +1,54 @@
+#ifndef __INSOTU_MPLSSCRIPTABLE_H
+#define __INSOTU_MPLSSCRIPTABLE_H
+
+#include <omnetpp.h>
+
+#include "inet/networklayer/mpls/Mpls.h"
+#include "LabelCounters.h"
+
+using namespace omnetpp;
+
+namespace insotu {
+
+class EgressSlaMonitor;
+
+/**
+ * MPLS forwarding with LSP OAM support
+ *
+ * - Ingress: sendLspProbe() pushes the label stack of a given LSP on an
+ *   OAM probe, independent of which LSP the FECs are currently bound to
+ * - Egress: probes arriving under the OAM alert label are returned to the
+ *   generating LspProbeGenerator instead of being delivered to IP
+ * - Per-in-label packet/byte counters: labelled packets are counted on
+ *   arrival (swap/pop), and ingress pushes are counted by the
+ *   RsvpClassifierScriptable the counters are attached to
+ * - Labelled packets arriving here are shown to an attached
+ *   EgressSlaMonitor, which measures the LSPs ending at this router
+ */
+class MplsScriptable : public inet::Mpls
+{
+  public:
+    // Reserved "OAM Alert" label (RFC 3429)
+    static const int OAM_ALERT_LABEL = 14;
+
+  protected:
+    LabelCounters labelCounters;
+    EgressSlaMonitor *slaMonitor = nullptr;
+
+  protected:
+    virtual void initialize(int stage) override;
+    virtual void processMplsPacketFromL2(inet::Packet *packet) override;
+
+    bool isOamProbeForEgress(inet::Packet *packet);
+    void reflectLspProbe(inet::Packet *packet);
+
+  public:
+    bool sendLspProbe(inet::Packet *probe, int inLabel);
+
+    const LabelCounters& getLabelCounters() const { return labelCounters; }
+    void setSlaMonitor(EgressSlaMonitor *monitor) { slaMonitor = monitor; }
+};
+
+} // namespace insotu
+
+#endif
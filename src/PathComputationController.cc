@@ -0,0 +1,366 @@
+#include "PathComputationController.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "RsvpTeScriptable.h"
+#include "inet/networklayer/common/L3AddressResolver.h"
+#include "inet/networklayer/common/NetworkInterface.h"
+#include "inet/networklayer/contract/IInterfaceTable.h"
+#include "inet/networklayer/ted/Ted.h"
+
+namespace insotu {
+
+Define_Module(PathComputationController);
+
+void PathComputationController::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled").boolValue();
+        if (!enabled)
+            return;
+
+        computeInterval = par("computeInterval");
+        batchDelay = par("batchDelay");
+        minImprovement = par("minImprovement").doubleValue();
+        maxIterations = par("maxIterations").intValue();
+        if (computeInterval <= 0)
+            throw cRuntimeError("computeInterval must be positive");
+
+        cStringTokenizer tokenizer(par("rsvpModules"));
+        while (const char *path = tokenizer.nextToken()) {
+            auto headend = dynamic_cast<RsvpTeScriptable *>(getModuleByPath(path));
+            if (!headend)
+                throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", path);
+            headends.push_back(headend);
+        }
+        if (headends.empty())
+            throw cRuntimeError("No headend RSVP modules configured");
+
+        const char *tedPath = par("tedModule");
+        ted = dynamic_cast<inet::Ted *>(getModuleByPath(tedPath));
+        if (!ted)
+            throw cRuntimeError("TED module '%s' not found", tedPath);
+
+        computeTimer = new cMessage("pceCompute");
+        triggerTimer = new cMessage("pceTrigger");
+        maxUtilizationSignal = registerSignal("maxUtilization");
+        movesSignal = registerSignal("placementMoves");
+
+        WATCH(numComputations);
+        WATCH(numMoves);
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (!enabled)
+            return;
+
+        for (auto headend : headends)
+            headend->setPathComputationController(this);
+
+        lastRateSample = simTime();
+        scheduleAt(simTime() + par("startTime"), computeTimer);
+    }
+}
+
+void PathComputationController::handleMessage(cMessage *msg)
+{
+    if (msg == computeTimer) {
+        computePlacement();
+        scheduleAt(simTime() + computeInterval, computeTimer);
+    }
+    else if (msg == triggerTimer) {
+        computePlacement();
+    }
+    else {
+        delete msg;
+    }
+}
+
+void PathComputationController::requestComputation(const char *source)
+{
+    Enter_Method("requestComputation");
+
+    if (!enabled || triggerTimer->isScheduled())
+        return;
+
+    EV_INFO << "Placement recomputation requested by " << source << endl;
+    scheduleAt(simTime() + batchDelay, triggerTimer);
+}
+
+void PathComputationController::updateTunnelRates()
+{
+    simtime_t now = simTime();
+    double dt = (now - lastRateSample).dbl();
+    if (dt <= 0)
+        return;
+    lastRateSample = now;
+
+    for (auto headend : headends) {
+        for (const auto& elem : headend->getTunnelLspOrder()) {
+            auto key = std::make_pair(headend, elem.first);
+            uint64_t bytes = headend->getTunnelBytes(elem.first);
+            auto it = lastTunnelBytes.find(key);
+            if (it != lastTunnelBytes.end()) {
+                // Label changes on re-signalling can make the sum go backwards
+                uint64_t diff = bytes >= it->second ? bytes - it->second : bytes;
+                tunnelRates[key] = diff * 8.0 / dt;
+            }
+            lastTunnelBytes[key] = bytes;
+        }
+    }
+}
+
+int PathComputationController::findLink(inet::Ipv4Address advrouter, inet::Ipv4Address hop) const
+{
+    for (size_t i = 0; i < ted->ted.size(); i++) {
+        const auto& link = ted->ted[i];
+        if (link.advrouter == advrouter && (link.linkid == hop || link.remote == hop))
+            return i;
+    }
+    return -1;
+}
+
+std::vector<int> PathComputationController::mapRoute(const std::vector<inet::Ipv4Address>& route) const
+{
+    std::vector<int> links;
+    for (size_t i = 1; i < route.size(); i++) {
+        int link = findLink(route[i - 1], route[i]);
+        if (link < 0) {
+            EV_WARN << "No TED link " << route[i - 1] << " -> " << route[i] << ", route mapped up to there" << endl;
+            break;
+        }
+        links.push_back(link);
+    }
+    return links;
+}
+
+cDatarateChannel *PathComputationController::findLinkChannel(int link)
+{
+    auto it = linkChannels.find(link);
+    if (it != linkChannels.end())
+        return it->second;
+
+    // Transmission channel of the advertising router's interface
+    cDatarateChannel *channel = nullptr;
+    const auto& info = ted->ted[link];
+    inet::L3AddressResolver resolver;
+    if (cModule *host = resolver.findHostWithAddress(info.local)) {
+        inet::IInterfaceTable *ift = resolver.findInterfaceTableOf(host);
+        inet::NetworkInterface *iface = ift ? ift->findInterfaceByAddress(info.local) : nullptr;
+        if (iface && iface->hasGate("phys$o"))
+            channel = dynamic_cast<cDatarateChannel *>(iface->gate("phys$o")->findTransmissionChannel());
+    }
+    if (!channel)
+        EV_WARN << "No channel for TED link " << info.advrouter << " -> " << info.linkid << ", using the advertised bandwidth" << endl;
+    linkChannels[link] = channel;
+    return channel;
+}
+
+void PathComputationController::updateLinkCapacities()
+{
+    // Current datarate (scenario changes, residual of fluid load); the TED only has the configured one
+    linkCapacity.assign(ted->ted.size(), 0.0);
+    for (size_t i = 0; i < ted->ted.size(); i++) {
+        cDatarateChannel *channel = findLinkChannel(i);
+        linkCapacity[i] = channel ? channel->getDatarate() : ted->ted[i].MaxBandwidth;
+    }
+}
+
+void PathComputationController::collectDemands(std::vector<TunnelDemand>& demands)
+{
+    for (auto headend : headends) {
+        for (const auto& elem : headend->getTunnelLspOrder()) {
+            TunnelDemand demand;
+            demand.headend = headend;
+            demand.tunnelId = elem.first;
+            demand.currentIndex = -1;
+            int activeLspId = headend->getActiveLspId(elem.first);
+
+            std::vector<RsvpTeScriptable::LspReport> reports = headend->reportTunnelLsps(elem.first);
+            double reserved = 0;
+            for (size_t index = 0; index < reports.size(); index++) {
+                const auto& report = reports[index];
+                if (report.lspId == activeLspId) {
+                    demand.currentIndex = index;
+                    reserved = report.reservedBandwidth;
+                }
+                if (!report.usable)
+                    continue;
+                Candidate candidate;
+                candidate.index = index;
+                candidate.congested = report.congested;
+                candidate.links = mapRoute(report.route);
+                if (!candidate.links.empty())
+                    demand.candidates.push_back(candidate);
+            }
+
+            // Measured rate; the reservation until a measurement is available
+            auto rateIt = tunnelRates.find(std::make_pair(headend, elem.first));
+            demand.demand = rateIt != tunnelRates.end() ? rateIt->second : reserved;
+
+            if (!demand.candidates.empty())
+                demands.push_back(demand);
+        }
+    }
+}
+
+void PathComputationController::addLoad(const TunnelDemand& demand, int candidate, std::vector<double>& load, double sign) const
+{
+    if (candidate < 0)
+        return;
+    for (int link : demand.candidates[candidate].links)
+        load[link] += sign * demand.demand;
+}
+
+double PathComputationController::getMaxUtilization(const std::vector<double>& load) const
+{
+    double maxUtilization = 0;
+    for (size_t i = 0; i < load.size(); i++) {
+        double capacity = linkCapacity[i];
+        if (capacity > 0)
+            maxUtilization = std::max(maxUtilization, load[i] / capacity);
+    }
+    return maxUtilization;
+}
+
+void PathComputationController::place(const std::vector<TunnelDemand>& demands, std::vector<int>& choice, std::vector<double>& load) const
+{
+    // Largest demands first, each on the candidate with the lowest resulting bottleneck
+    std::vector<size_t> order(demands.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return demands[a].demand > demands[b].demand; });
+
+    for (size_t t : order) {
+        const TunnelDemand& demand = demands[t];
+        int best = -1;
+        double bestUtilization = 0;
+        for (size_t c = 0; c < demand.candidates.size(); c++) {
+            double utilization = 0;
+            for (int link : demand.candidates[c].links) {
+                double capacity = linkCapacity[link];
+                if (capacity > 0)
+                    utilization = std::max(utilization, (load[link] + demand.demand) / capacity);
+            }
+            bool preferred = best >= 0 && utilization == bestUtilization && demand.candidates[c].index == demand.currentIndex;
+            if (best < 0 || utilization < bestUtilization || preferred) {
+                best = c;
+                bestUtilization = utilization;
+            }
+        }
+        choice[t] = best;
+        addLoad(demand, best, load, 1);
+    }
+}
+
+void PathComputationController::improve(const std::vector<TunnelDemand>& demands, std::vector<int>& choice, std::vector<double>& load) const
+{
+    // Move single tunnels off the bottleneck while that lowers the maximum utilization
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        double current = getMaxUtilization(load);
+        bool moved = false;
+        for (size_t t = 0; t < demands.size() && !moved; t++) {
+            for (size_t c = 0; c < demands[t].candidates.size() && !moved; c++) {
+                if ((int)c == choice[t])
+                    continue;
+                addLoad(demands[t], choice[t], load, -1);
+                addLoad(demands[t], c, load, 1);
+                if (getMaxUtilization(load) < current - 1e-9) {
+                    choice[t] = c;
+                    moved = true;
+                }
+                else {
+                    addLoad(demands[t], c, load, -1);
+                    addLoad(demands[t], choice[t], load, 1);
+                }
+            }
+        }
+        if (!moved)
+            break;
+    }
+}
+
+void PathComputationController::computePlacement()
+{
+    updateTunnelRates();
+
+    std::vector<TunnelDemand> demands;
+    collectDemands(demands);
+    if (demands.empty())
+        return;
+    numComputations++;
+    updateLinkCapacities();
+
+    // Utilization of the current placement
+    std::vector<double> currentLoad(ted->ted.size(), 0.0);
+    for (const auto& demand : demands) {
+        for (size_t c = 0; c < demand.candidates.size(); c++)
+            if (demand.candidates[c].index == demand.currentIndex)
+                addLoad(demand, c, currentLoad, 1);
+    }
+
+    // Links reported congested carry load the model does not know about:
+    // fill them up to capacity, for the current and the new placement alike
+    std::vector<double> background(ted->ted.size(), 0.0);
+    for (const auto& demand : demands) {
+        for (const auto& candidate : demand.candidates) {
+            if (!candidate.congested)
+                continue;
+            for (int link : candidate.links)
+                background[link] = std::max(background[link], linkCapacity[link] - currentLoad[link]);
+        }
+    }
+    for (size_t i = 0; i < currentLoad.size(); i++)
+        currentLoad[i] += background[i];
+    double currentMax = getMaxUtilization(currentLoad);
+
+    std::vector<int> choice(demands.size(), -1);
+    std::vector<double> load = background;
+    place(demands, choice, load);
+    improve(demands, choice, load);
+    double newMax = getMaxUtilization(load);
+
+    EV_INFO << "Placement of " << demands.size() << " tunnels: max utilization " << currentMax
+            << " -> " << newMax << endl;
+
+    // Tunnels without a usable current LSP are always moved; otherwise require a gain
+    bool currentValid = std::all_of(demands.begin(), demands.end(), [](const TunnelDemand& d) {
+        return std::any_of(d.candidates.begin(), d.candidates.end(), [&](const Candidate& c) { return c.index == d.currentIndex; });
+    });
+    if (currentValid && currentMax - newMax < minImprovement) {
+        emit(maxUtilizationSignal, currentMax);
+        return;
+    }
+
+    // One batch per headend
+    std::map<RsvpTeScriptable *, std::map<int, int>> batches;
+    for (size_t t = 0; t < demands.size(); t++) {
+        int index = demands[t].candidates[choice[t]].index;
+        if (index != demands[t].currentIndex)
+            batches[demands[t].headend][demands[t].tunnelId] = index;
+    }
+
+    long moves = 0;
+    for (auto& batch : batches) {
+        EV_INFO << "Pushing " << batch.second.size() << " LSP changes to " << batch.first->getFullPath() << endl;
+        batch.first->applyPlacement(batch.second, "pce");
+        moves += batch.second.size();
+    }
+    numMoves += moves;
+    emit(movesSignal, moves);
+    emit(maxUtilizationSignal, newMax);
+}
+
+void PathComputationController::finish()
+{
+    recordScalar("computations", numComputations);
+    recordScalar("moves", numMoves);
+
+    cancelAndDelete(computeTimer);
+    computeTimer = nullptr;
+    cancelAndDelete(triggerTimer);
+    triggerTimer = nullptr;
+}
+
+} // namespace insotu
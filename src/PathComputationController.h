@@ -0,0 +1,107 @@
+#ifndef __INSOTU_PATHCOMPUTATIONCONTROLLER_H
+#define __INSOTU_PATHCOMPUTATIONCONTROLLER_H
+
+#include <map>
+#include <vector>
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+#include "inet/networklayer/rsvpte/IntServ_m.h"
+
+using namespace omnetpp;
+
+namespace inet {
+class Ted;
+}
+
+namespace insotu {
+
+class RsvpTeScriptable;
+
+/**
+ * Centralized stateful path computation (local PCE stand-in)
+ *
+ * Collects LSP state and measured tunnel rates from every attached headend,
+ * maps each usable LSP onto TED links (by its full route, with hops the ERO
+ * leaves open taken from the TED), and computes a joint placement of all
+ * tunnels that minimizes the maximum link utilization. The chosen LSP
+ * indices are pushed back to each headend in one batch.
+ *
+ * Link capacities are the current datarates of the links' channels, so
+ * datarate changes and fluid background load are seen. Links of an LSP
+ * that was active when its tunnel reported congestion count as saturated
+ * (load the model does not know fills them up to capacity).
+ *
+ * Headends delegate congestion handling to the controller once attached;
+ * link failures and primary restoration are still handled locally and
+ * trigger a recomputation.
+ */
+class PathComputationController : public cSimpleModule
+{
+  protected:
+    struct Candidate {
+        int index = -1;
+        bool congested = false;
+        std::vector<int> links;             // indices into the TED link table
+    };
+
+    struct TunnelDemand {
+        RsvpTeScriptable *headend = nullptr;
+        int tunnelId = -1;
+        int currentIndex = -1;
+        double demand = 0;                  // bps
+        std::vector<Candidate> candidates;
+    };
+
+    // Parameters
+    bool enabled = true;
+    simtime_t computeInterval;
+    simtime_t batchDelay;
+    double minImprovement = 0;
+    int maxIterations = 0;
+
+    // References
+    std::vector<RsvpTeScriptable *> headends;
+    inet::Ted *ted = nullptr;
+    std::map<int, cDatarateChannel *> linkChannels;     // by TED link, nullptr if not found
+    std::vector<double> linkCapacity;                   // bps, per TED link for the current computation
+
+    // Rate measurement per (headend, tunnel)
+    std::map<std::pair<RsvpTeScriptable *, int>, uint64_t> lastTunnelBytes;
+    std::map<std::pair<RsvpTeScriptable *, int>, double> tunnelRates;
+    simtime_t lastRateSample;
+
+    cMessage *computeTimer = nullptr;
+    cMessage *triggerTimer = nullptr;
+
+    // Statistics
+    long numComputations = 0;
+    long numMoves = 0;
+    simsignal_t maxUtilizationSignal;
+    simsignal_t movesSignal;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    void updateTunnelRates();
+    void collectDemands(std::vector<TunnelDemand>& demands);
+    std::vector<int> mapRoute(const std::vector<inet::Ipv4Address>& route) const;
+    int findLink(inet::Ipv4Address advrouter, inet::Ipv4Address hop) const;
+    cDatarateChannel *findLinkChannel(int link);
+    void updateLinkCapacities();
+    double getMaxUtilization(const std::vector<double>& load) const;
+    void place(const std::vector<TunnelDemand>& demands, std::vector<int>& choice, std::vector<double>& load) const;
+    void improve(const std::vector<TunnelDemand>& demands, std::vector<int>& choice, std::vector<double>& load) const;
+    void addLoad(const TunnelDemand& demand, int candidate, std::vector<double>& load, double sign) const;
+    void computePlacement();
+
+  public:
+    // Asks for a recomputation; requests within batchDelay are coalesced
+    void requestComputation(const char *source);
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef __INSOTU_PATHSELECTIONPOLICY_H
+#define __INSOTU_PATHSELECTIONPOLICY_H
+
+#include <algorithm>
+#include <vector>
+
+namespace insotu {
+
+/**
+ * Path selection policies for RsvpTeScriptable
+ *
+ * A policy decides which LSP of a tunnel takes the traffic on failover and
+ * when traffic may return to the primary. Policies are stateless classes
+ * with static members; RsvpTeScriptable picks one by the selectionPolicy
+ * parameter at initialization and instantiates its decision code per
+ * policy, so the selection loop is inlined without virtual dispatch.
+ *
+ * A policy provides:
+ * - needsLatency / needsHeadroom: which PathCandidate metrics to fill in
+ * - selectFailover(paths, currentIndex, primaryIndex): index to switch to,
+ *   or -1 if no path qualifies
+ * - restoreDelay(context): seconds until traffic may return to the
+ *   primary, 0 for now, negative for not automatically
+ *
+ * New policies are added here and to the selectionPolicy switch statements
+ * in RsvpTeScriptable.
+ */
+struct PathCandidate {
+    bool defined = false;       // LSP configured in the traffic file
+    bool ready = false;         // PSB and label installed
+    bool srlgRisk = false;      // shares an SRLG in which an LSP has failed
+    bool drained = false;       // traverses a drained router
+    bool down = false;          // primary known to be unavailable, or crossing a TED link that is down
+    double latency = 0;         // measured one-way delay (s), 0 if not probed
+    double cost = 0;            // sum of TED metrics along the route
+    double headroom = 0;        // unreserved bandwidth at the route bottleneck (bps)
+
+    bool eligible() const { return defined && !srlgRisk && !drained && !down; }
+};
+
+struct RestoreContext {
+    bool commanded = false;     // explicit scenario command
+    double sinceSwitch = 0;     // seconds on the current LSP
+    double holdTime = 0;        // revertHoldTime parameter (s)
+};
+
+/**
+ * Configured order: the next backup after the current one (ready before
+ * needing setup), then the primary, then any ready path, then backups in a
+ * failed SRLG. Revertive without delay.
+ */
+struct OrderedPolicy {
+    static constexpr bool needsLatency = false;
+    static constexpr bool needsHeadroom = false;
+    static const char *getName() { return "ordered"; }
+
+    static int selectFailover(const std::vector<PathCandidate>& paths, int currentIndex, int primaryIndex)
+    {
+        int size = paths.size();
+        int setup = -1;
+        for (int i = currentIndex + 1; i < size; i++) {
+            if (!paths[i].eligible())
+                continue;
+            if (paths[i].ready)
+                return i;
+            if (setup < 0)
+                setup = i;
+        }
+        if (setup >= 0)
+            return setup;
+
+        if (currentIndex != primaryIndex && paths[primaryIndex].eligible())
+            return primaryIndex;
+
+        for (int i = 0; i < size; i++) {
+            if (i != currentIndex && paths[i].defined && paths[i].ready && !paths[i].drained && !paths[i].down)
+                return i;
+        }
+
+        for (int i = currentIndex + 1; i < size; i++) {
+            if (paths[i].defined && !paths[i].drained && !paths[i].down)
+                return i;
+        }
+        return -1;
+    }
+
+    static double restoreDelay(const RestoreContext&) { return 0; }
+};
+
+/**
+ * Ready path with the lowest probed delay (TED metric sum unless every
+ * candidate has been probed); ordered selection if no path is ready.
+ */
+struct LowestLatencyPolicy : OrderedPolicy {
+    static constexpr bool needsLatency = true;
+    static const char *getName() { return "lowest-latency"; }
+
+    static int selectFailover(const std::vector<PathCandidate>& paths, int currentIndex, int primaryIndex)
+    {
+        bool probed = true;
+        for (int i = 0; i < (int)paths.size(); i++) {
+            if (i != currentIndex && paths[i].eligible() && paths[i].ready && paths[i].latency <= 0)
+                probed = false;
+        }
+
+        int best = -1;
+        for (int i = 0; i < (int)paths.size(); i++) {
+            if (i == currentIndex || !paths[i].eligible() || !paths[i].ready)
+                continue;
+            double value = probed ? paths[i].latency : paths[i].cost;
+            double bestValue = best < 0 ? 0 : probed ? paths[best].latency : paths[best].cost;
+            if (best < 0 || value < bestValue)
+                best = i;
+        }
+        return best >= 0 ? best : OrderedPolicy::selectFailover(paths, currentIndex, primaryIndex);
+    }
+};
+
+/**
+ * Ready path with the most unreserved bandwidth at its bottleneck link;
+ * ordered selection if no path is ready.
+ */
+struct MostHeadroomPolicy : OrderedPolicy {
+    static constexpr bool needsHeadroom = true;
+    static const char *getName() { return "most-headroom"; }
+
+    static int selectFailover(const std::vector<PathCandidate>& paths, int currentIndex, int primaryIndex)
+    {
+        int best = -1;
+        for (int i = 0; i < (int)paths.size(); i++) {
+            if (i == currentIndex || !paths[i].eligible() || !paths[i].ready)
+                continue;
+            if (best < 0 || paths[i].headroom > paths[best].headroom)
+                best = i;
+        }
+        return best >= 0 ? best : OrderedPolicy::selectFailover(paths, currentIndex, primaryIndex);
+    }
+};
+
+/**
+ * Ordered failover, but traffic stays where it is until that path fails;
+ * only a scenario command moves it back to the primary.
+ */
+struct StickyPolicy : OrderedPolicy {
+    static const char *getName() { return "sticky"; }
+
+    static double restoreDelay(const RestoreContext& context) { return context.commanded ? 0 : -1; }
+};
+
+/**
+ * Ordered failover; returns to the primary only after the tunnel has been
+ * on its current LSP for revertHoldTime, so a flapping condition cannot
+ * move it back and forth faster than that.
+ */
+struct RevertivePolicy : OrderedPolicy {
+    static const char *getName() { return "revertive"; }
+
+    static double restoreDelay(const RestoreContext& context)
+    {
+        if (context.commanded)
+            return 0;
+        return std::max(0.0, context.holdTime - context.sinceSwitch);
+    }
+};
+
+} // namespace insotu
+
+#endif
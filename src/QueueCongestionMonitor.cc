@@ -1,6 +1,9 @@
 #include "QueueCongestionMonitor.h"
 
+#include "FluidLinkLoad.h"
 #include "RsvpTeScriptable.h"
+#include "inet/common/Simsignals.h"
+#include "inet/common/packet/Packet.h"
 #include "inet/queueing/contract/IPacketQueue.h"
 #include <omnetpp.h>
 
@@ -25,13 +28,32 @@ void QueueCongestionMonitor::initialize(int stage)
         lowWatermark = par("lowWatermark");
         interval = par("checkInterval");
 
-        if (highWatermark <= lowWatermark)
+        const char *mode = par("detectionMode");
+        if (!strcmp(mode, "depth"))
+            detectionMode = MODE_DEPTH;
+        else if (!strcmp(mode, "sojourn"))
+            detectionMode = MODE_SOJOURN;
+        else
+            throw cRuntimeError("Unknown detectionMode '%s'", mode);
+
+        if (detectionMode == MODE_DEPTH && highWatermark <= lowWatermark)
             throw cRuntimeError("highWatermark must be greater than lowWatermark");
 
+        targetSojournTime = par("targetSojournTime");
+        sojournInterval = par("sojournInterval");
+        if (detectionMode == MODE_SOJOURN && (targetSojournTime <= 0 || sojournInterval <= 0))
+            throw cRuntimeError("targetSojournTime and sojournInterval must be positive");
+
+        double minInterval = par("minCheckInterval").doubleValue();
+        double maxInterval = par("maxCheckInterval").doubleValue();
+        if (minInterval <= 0 || minInterval > maxInterval)
+            throw cRuntimeError("minCheckInterval must be positive and not greater than maxCheckInterval");
+        sampling.configure(par("adaptiveSampling").boolValue(), minInterval, maxInterval);
+
         const char *queuePath = par("queueModule");
         const char *rsvpPath = par("rsvpModule");
 
-        cModule *queueModule = queuePath && *queuePath ? getModuleByPath(queuePath) : nullptr;
+        queueModule = queuePath && *queuePath ? getModuleByPath(queuePath) : nullptr;
         queue = queueModule ? dynamic_cast<IPacketQueue *>(queueModule) : nullptr;
         if (!queue)
             throw cRuntimeError("Queue module '%s' is not an IPacketQueue", queuePath ? queuePath : "<null>");
@@ -41,12 +63,25 @@ void QueueCongestionMonitor::initialize(int stage)
         if (!rsvp)
             throw cRuntimeError("RSVP module '%s' is not an insotu RsvpTeScriptable", rsvpPath ? rsvpPath : "<null>");
 
+        const char *fluidPath = par("fluidModule");
+        if (fluidPath && *fluidPath) {
+            fluid = dynamic_cast<insotu::FluidLinkLoad *>(getModuleByPath(fluidPath));
+            if (!fluid)
+                throw cRuntimeError("Fluid module '%s' is not an insotu FluidLinkLoad", fluidPath);
+            fluidPacketSize = par("fluidPacketSize").doubleValue();
+        }
+
         timer = new cMessage("poll");
         WATCH(congested);
+        WATCH(lastSojourn);
     }
     else if (stage == inet::INITSTAGE_LAST) {
-        if (enabled && timer)
+        if (enabled && timer) {
+            // Same source as the queue's queueingTime statistic
+            if (detectionMode == MODE_SOJOURN)
+                queueModule->subscribe(inet::packetPulledSignal, this);
             scheduleAt(simTime(), timer);
+        }
     }
 }
 
@@ -54,7 +89,7 @@ void QueueCongestionMonitor::handleMessage(cMessage *msg)
 {
     if (msg == timer) {
         poll();
-        scheduleAt(simTime() + interval, timer);
+        scheduleAt(simTime() + sampling.nextInterval(interval.dbl()), timer);
     }
     else {
         delete msg;
@@ -63,25 +98,101 @@ void QueueCongestionMonitor::handleMessage(cMessage *msg)
 
 void QueueCongestionMonitor::finish()
 {
+    if (queueModule && queueModule->isSubscribed(inet::packetPulledSignal, this))
+        queueModule->unsubscribe(inet::packetPulledSignal, this);
+
     cancelAndDelete(timer);
     timer = nullptr;
 }
 
+void QueueCongestionMonitor::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    if (signalID != inet::packetPulledSignal || !enabled)
+        return;
+
+    // The queue stamps the arrival time on push, so this is the packet's queueing time
+    auto packet = check_and_cast<inet::Packet *>(obj);
+    noteSojourn(simTime() - packet->getArrivalTime() + getFluidDelay());
+}
+
 void QueueCongestionMonitor::poll()
 {
     if (!enabled || !queue || !rsvp)
         return;
 
+    if (detectionMode == MODE_SOJOURN) {
+        pollSojourn();
+        return;
+    }
+
     int depth = queue->getNumPackets();
+    if (fluid)
+        depth += (int)(fluid->getBacklogBytes() / fluidPacketSize);
+
+    if (!congested && depth >= highWatermark)
+        setCongested(true);
+    else if (congested && depth <= lowWatermark)
+        setCongested(false);
 
-    if (!congested && depth >= highWatermark) {
-        congested = true;
-        rsvp->handleCongestionNotification(tunnelId, true, getFullPath().c_str());
+    sampling.reset();
+    sampling.note(depth, congested ? lowWatermark : highWatermark, highWatermark - lowWatermark);
+}
+
+void QueueCongestionMonitor::pollSojourn()
+{
+    // Departures drive the detection; polling covers the cases without
+    // any: an empty queue counts as below target, and a head-of-line packet
+    // already waiting longer than the target as above it
+    simtime_t sojourn = getFluidDelay();
+    if (queue->getNumPackets() > 0) {
+        inet::Packet *head = queue->getPacket(0);
+        simtime_t waiting = head ? simTime() - head->getArrivalTime() : SIMTIME_ZERO;
+        if (waiting + sojourn >= targetSojournTime)
+            noteSojourn(waiting + sojourn);
+    }
+    else
+        noteSojourn(sojourn);
+
+    sampling.reset();
+    sampling.note(lastSojourn.dbl(), targetSojournTime.dbl(), targetSojournTime.dbl());
+}
+
+void QueueCongestionMonitor::noteSojourn(simtime_t sojourn)
+{
+    simtime_t now = simTime();
+    lastSojourn = sojourn;
+
+    if (sojourn >= targetSojournTime) {
+        belowTargetUntil = 0;
+        if (aboveTargetUntil == 0)
+            aboveTargetUntil = now + sojournInterval;
+        else if (!congested && now >= aboveTargetUntil) {
+            EV_WARN << "Sojourn time above " << targetSojournTime << "s for " << sojournInterval
+                    << "s (now " << sojourn << "s)" << endl;
+            setCongested(true);
+        }
     }
-    else if (congested && depth <= lowWatermark) {
-        congested = false;
-        rsvp->handleCongestionNotification(tunnelId, false, getFullPath().c_str());
+    else {
+        aboveTargetUntil = 0;
+        if (belowTargetUntil == 0)
+            belowTargetUntil = now + sojournInterval;
+        else if (congested && now >= belowTargetUntil)
+            setCongested(false);
     }
 }
 
+simtime_t QueueCongestionMonitor::getFluidDelay()
+{
+    // Fluid backlog is served ahead of the packets at the nominal capacity
+    if (!fluid || fluid->getCapacity() <= 0)
+        return 0;
+    return fluid->getBacklogBytes() * 8 / fluid->getCapacity();
+}
+
+void QueueCongestionMonitor::setCongested(bool congested)
+{
+    this->congested = congested;
+    rsvp->handleCongestionNotification(tunnelId, congested, getFullPath().c_str());
+}
+
 } // namespace insotu
@@ -4,6 +4,8 @@
 #include <omnetpp.h>
 #include "inet/common/InitStages.h"
 
+#include "AdaptiveSampling.h"
+
 using namespace omnetpp;
 
 namespace inet {
@@ -14,28 +16,60 @@ class IPacketQueue;
 
 namespace insotu {
 
+class FluidLinkLoad;
 class RsvpTeScriptable;
 
-class QueueCongestionMonitor : public cSimpleModule
+/**
+ * Queue congestion detector for a tunnel's outgoing interface
+ *
+ * detectionMode "depth" compares the number of queued packets against
+ * high/lowWatermark. "sojourn" detects like CoDel: the queueing time of
+ * every packet leaving the queue is checked against targetSojournTime, and
+ * the tunnel is congested once it has stayed above the target for a whole
+ * sojournInterval (i.e. the minimum sojourn time over the interval exceeds
+ * the target); it is clear again after an interval entirely below. Being
+ * expressed in time, the sojourn thresholds hold regardless of the link
+ * datarate and packet sizes.
+ */
+class QueueCongestionMonitor : public cSimpleModule, public cListener
 {
   protected:
+    enum DetectionMode { MODE_DEPTH, MODE_SOJOURN };
+
     inet::queueing::IPacketQueue *queue = nullptr;
+    cModule *queueModule = nullptr;
     insotu::RsvpTeScriptable *rsvp = nullptr;
+    insotu::FluidLinkLoad *fluid = nullptr;     // optional fluid background load
+    double fluidPacketSize = 0;                 // bytes per packet-equivalent of fluid backlog
     cMessage *timer = nullptr;
     int tunnelId = -1;
     int highWatermark = 0;
     int lowWatermark = 0;
     bool congested = false;
     simtime_t interval = 0;
+    AdaptiveSampling sampling;                  // poll faster near the watermarks
     bool enabled = true;
+    DetectionMode detectionMode = MODE_DEPTH;
+
+    // Sojourn mode
+    simtime_t targetSojournTime = 0;
+    simtime_t sojournInterval = 0;
+    simtime_t aboveTargetUntil = 0;             // congested if still above target then; 0 while below
+    simtime_t belowTargetUntil = 0;             // clear if still below target then; 0 while above
+    simtime_t lastSojourn = 0;
 
   protected:
     virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
     virtual void initialize(int stage) override;
     virtual void handleMessage(cMessage *msg) override;
     virtual void finish() override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
 
     void poll();
+    void pollSojourn();
+    void noteSojourn(simtime_t sojourn);
+    simtime_t getFluidDelay();
+    void setCongested(bool congested);
 };
 
 } // namespace insotu
@@ -1,4 +1,6 @@
 #include "RsvpClassifierScriptable.h"
+#include "TopologyImageLoader.h"
+#include "inet/networklayer/ipv4/Ipv4Header_m.h"
 #include <omnetpp.h>
 
 namespace insotu {
@@ -7,6 +9,70 @@ using namespace omnetpp;
 
 Define_Module(RsvpClassifierScriptable);
 
+void RsvpClassifierScriptable::initialize(int stage)
+{
+    inet::RsvpClassifier::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        const char *imagePath = par("topologyImageModule");
+        if (*imagePath) {
+            topologyImage = dynamic_cast<TopologyImageLoader *>(getModuleByPath(imagePath));
+            if (!topologyImage)
+                throw cRuntimeError("Module '%s' is not an insotu TopologyImageLoader", imagePath);
+        }
+    }
+}
+
+void RsvpClassifierScriptable::readTableFromXML(const cXMLElement *fectable)
+{
+    inet::RsvpClassifier::readTableFromXML(fectable);
+
+    const TopologyImage *image = topologyImage ? topologyImage->getImage() : nullptr;
+    const TopologyImage::Router *router = image ? topologyImage->findRouter(this) : nullptr;
+    if (!router || router->numFecs == 0)
+        return;
+    if (!bindings.empty())
+        throw cRuntimeError("FEC entries are configured both in the config parameter and in the topology image");
+
+    for (const auto& fec : image->getFecs(*router)) {
+        FecEntry entry;
+        entry.id = fec.id;
+        entry.src = inet::Ipv4Address(fec.src);
+        entry.dest = inet::Ipv4Address(fec.dest);
+        entry.session.DestAddress = inet::Ipv4Address(fec.sessionDest);
+        entry.session.Tunnel_Id = fec.tunnelId;
+        entry.session.Extended_Tunnel_Id = fec.extendedTunnelId;
+        entry.session.setupPri = fec.setupPri;
+        entry.session.holdingPri = fec.holdingPri;
+        entry.sender.SrcAddress = inet::Ipv4Address(fec.senderAddress);
+        entry.sender.Lsp_Id = fec.lspId;
+        // Labels are allocated at run time, as for entries read from XML
+        entry.inLabel = rsvp->getInLabel(entry.session, entry.sender);
+        bindings.push_back(entry);
+    }
+
+    EV_INFO << "Loaded " << router->numFecs << " FEC entries from topology image" << inet::endl;
+}
+
+void RsvpClassifierScriptable::storeFecEntries(TopologyImage::Builder& builder) const
+{
+    for (const auto& entry : bindings) {
+        TopologyImage::Fec fec;
+        fec.id = entry.id;
+        fec.src = entry.src.getInt();
+        fec.dest = entry.dest.getInt();
+        fec.sessionDest = entry.session.DestAddress.getInt();
+        fec.tunnelId = entry.session.Tunnel_Id;
+        fec.extendedTunnelId = entry.session.Extended_Tunnel_Id;
+        fec.setupPri = entry.session.setupPri;
+        fec.holdingPri = entry.session.holdingPri;
+        fec.senderAddress = entry.sender.SrcAddress.getInt();
+        fec.lspId = entry.sender.Lsp_Id;
+        fec.inLabel = entry.inLabel;
+        builder.addFec(fec);
+    }
+}
+
 void RsvpClassifierScriptable::bind(const inet::SessionObj& session, const inet::SenderTemplateObj& sender, int inLabel)
 {
     if (allowAutomaticBinding) {
@@ -21,6 +87,40 @@ void RsvpClassifierScriptable::bind(const inet::SessionObj& session, const inet:
     }
 }
 
+bool RsvpClassifierScriptable::lookupLabel(inet::Packet *packet, inet::LabelOpVector& outLabel, std::string& outInterface, int& color)
+{
+    const auto& ipv4Header = packet->peekAtFront<inet::Ipv4Header>();
+
+    // never label OSPF(TED) and RSVP traffic
+    switch (ipv4Header->getProtocolId()) {
+        case inet::IP_PROT_OSPF:
+        case inet::IP_PROT_RSVP:
+            return false;
+        default:
+            break;
+    }
+
+    // Same FEC match as RsvpClassifier, but the matched in-label is needed for counting
+    for (const auto& fec : bindings) {
+        if (!fec.dest.isUnspecified() && !fec.dest.equals(ipv4Header->getDestAddress()))
+            continue;
+        if (!fec.src.isUnspecified() && !fec.src.equals(ipv4Header->getSrcAddress()))
+            continue;
+
+        EV_DETAIL << "packet belongs to fecid=" << fec.id << inet::endl;
+        if (fec.inLabel < 0)
+            return false;
+        if (!lt->resolveLabel("", fec.inLabel, outLabel, outInterface, color))
+            return false;
+
+        if (labelCounters)
+            labelCounters->count(fec.inLabel, packet->getByteLength());
+        return true;
+    }
+
+    return false;
+}
+
 void RsvpClassifierScriptable::rebindFec(int fecId, const inet::SessionObj& session, const inet::SenderTemplateObj& sender, int inLabel)
 {
     auto it = findFEC(fecId);
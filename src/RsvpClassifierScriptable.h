@@ -3,17 +3,33 @@
 
 #include "inet/networklayer/rsvpte/RsvpClassifier.h"
 #include "inet/networklayer/rsvpte/RsvpTe.h"
+#include "LabelCounters.h"
+#include "TopologyImage.h"
 
 namespace insotu {
 
+class TopologyImageLoader;
+
 class RsvpClassifierScriptable : public inet::RsvpClassifier
 {
   protected:
+    virtual void initialize(int stage) override;
+
+    // Also loads the FEC entries of this router from the topology image, if one is attached
+    virtual void readTableFromXML(const omnetpp::cXMLElement *fectable) override;
+
     // Override bind to prevent automatic FEC updates during LSP restoration
     virtual void bind(const inet::SessionObj& session, const inet::SenderTemplateObj& sender, int inLabel) override;
 
+    // Counts labelled packets per in-label at the ingress (counters owned by MplsScriptable)
+    virtual bool lookupLabel(inet::Packet *packet, inet::LabelOpVector& outLabel, std::string& outInterface, int& color) override;
+
     bool allowAutomaticBinding = true; // Allow binding during initialization
 
+    LabelCounters *labelCounters = nullptr;
+
+    TopologyImageLoader *topologyImage = nullptr;
+
   public:
     RsvpClassifierScriptable() = default;
 
@@ -23,6 +39,13 @@ class RsvpClassifierScriptable : public inet::RsvpClassifier
 
     // Control automatic binding
     void setAllowAutomaticBinding(bool allow) { allowAutomaticBinding = allow; }
+
+    // Per-label traffic counters of the forwarding path (nullptr if not attached)
+    void setLabelCounters(LabelCounters *counters) { labelCounters = counters; }
+    const LabelCounters *getLabelCounters() const { return labelCounters; }
+
+    // Adds the FEC table to a topology image being compiled
+    void storeFecEntries(TopologyImage::Builder& builder) const;
 };
 
 } // namespace insotu
@@ -1,19 +1,32 @@
 #include "RsvpTeScriptable.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <omnetpp.h>
 
+#include "LspProbeGenerator.h"
+#include "PathComputationController.h"
 #include "RsvpClassifierScriptable.h"
+#include "RsvpRefresh_m.h"
+#include "RsvpSlaNotify_m.h"
+#include "TopologyImageLoader.h"
 #include "inet/common/INETDefs.h"
 #include "inet/common/Simsignals.h"
 #include "inet/common/Protocol.h"
 #include "inet/common/ProtocolTag_m.h"
 #include "inet/common/packet/Packet.h"
+#include "inet/networklayer/common/L3AddressResolver.h"
+#include "inet/networklayer/common/L3AddressTags_m.h"
+#include "inet/networklayer/common/NetworkInterface.h"
+#include "inet/networklayer/contract/IInterfaceTable.h"
 #include "inet/networklayer/ipv4/IcmpHeader_m.h"
 #include "inet/networklayer/rsvpte/RsvpPacket_m.h"
 #include "inet/networklayer/rsvpte/SignallingMsg_m.h"
+#include "inet/networklayer/ted/LinkStatePacket_m.h"
+#include "inet/networklayer/ted/Ted.h"
 
 namespace insotu {
 
@@ -31,16 +44,85 @@ void RsvpTeScriptable::initialize(int stage)
 
     if (stage == inet::INITSTAGE_LOCAL) {
         autoRestorePrimary = par("autoRestorePrimary").boolValue();
+        const char *policy = par("selectionPolicy");
+        if (!strcmp(policy, "ordered"))
+            selectionPolicy = POLICY_ORDERED;
+        else if (!strcmp(policy, "lowest-latency"))
+            selectionPolicy = POLICY_LOWEST_LATENCY;
+        else if (!strcmp(policy, "most-headroom"))
+            selectionPolicy = POLICY_MOST_HEADROOM;
+        else if (!strcmp(policy, "sticky"))
+            selectionPolicy = POLICY_STICKY;
+        else if (!strcmp(policy, "revertive"))
+            selectionPolicy = POLICY_REVERTIVE;
+        else
+            throw cRuntimeError("Unknown selectionPolicy '%s'", policy);
+        revertHoldTime = par("revertHoldTime");
+        tedInvalidation = par("tedInvalidation").boolValue();
+        WATCH(numSwitches);
         restorationDelay = par("restorationDelay");
+        flapDamping = par("flapDamping").boolValue();
+        flapPenalty = par("flapPenalty").doubleValue();
+        flapSuppressThreshold = par("flapSuppressThreshold").doubleValue();
+        flapReuseThreshold = par("flapReuseThreshold").doubleValue();
+        flapHalfLife = par("flapHalfLife");
+        flapMaxHoldTime = par("flapMaxHoldTime");
+        if (flapDamping && flapReuseThreshold >= flapSuppressThreshold)
+            throw cRuntimeError("flapReuseThreshold must be lower than flapSuppressThreshold");
+        if (flapDamping && flapHalfLife <= 0)
+            throw cRuntimeError("flapHalfLife must be positive");
         restorationCheckTimer = new cMessage("restorationCheck");
+        signallingPacing = par("signallingPacing").boolValue();
+        signallingRate = par("signallingRate").doubleValue();
+        signallingBurst = par("signallingBurst").doubleValue();
+        if (signallingPacing && (signallingRate <= 0 || signallingBurst < 1))
+            throw cRuntimeError("signallingRate must be positive and signallingBurst at least 1");
+        signallingTokens = signallingBurst;
+        signallingTimer = new cMessage("signallingPacing");
+        signallingQueueDepthSignal = registerSignal("signallingQueueDepth");
+        refreshReduction = par("refreshReduction").boolValue();
+        summaryRefreshInterval = par("summaryRefreshInterval");
+        if (refreshReduction && summaryRefreshInterval <= 0)
+            throw cRuntimeError("summaryRefreshInterval must be positive");
+        WATCH(numSummaryRefreshesSent);
+        WATCH(numSummaryEntriesSent);
+        autoBandwidth = par("autoBandwidth").boolValue();
+        autoBandwidthSampleInterval = par("autoBandwidthSampleInterval");
+        autoBandwidthInterval = par("autoBandwidthInterval");
+        autoBandwidthHeadroom = par("autoBandwidthHeadroom").doubleValue();
+        autoBandwidthThreshold = par("autoBandwidthThreshold").doubleValue();
+        autoBandwidthMin = par("autoBandwidthMin").doubleValue();
+        autoBandwidthMax = par("autoBandwidthMax").doubleValue();
+        if (autoBandwidth && (autoBandwidthSampleInterval <= 0 || autoBandwidthInterval < autoBandwidthSampleInterval))
+            throw cRuntimeError("autoBandwidthSampleInterval must be positive and not longer than autoBandwidthInterval");
+        if (autoBandwidth && autoBandwidthMax > 0 && autoBandwidthMax < autoBandwidthMin)
+            throw cRuntimeError("autoBandwidthMax must not be lower than autoBandwidthMin");
+        autoBandwidthTimer = new cMessage("autoBandwidth");
+        WATCH(numResizes);
+        flightRecorder.setCapacity(par("flightRecorderSize").intValue());
+        flightRecorderFile = par("flightRecorderFile").stdstringValue();
         classifierExt = dynamic_cast<insotu::RsvpClassifierScriptable *>(rpct.get());
         if (!classifierExt)
             throw cRuntimeError("RsvpTeScriptable requires insotu::RsvpClassifierScriptable as classifier module");
+        const char *imagePath = par("topologyImageModule");
+        if (*imagePath) {
+            topologyImage = dynamic_cast<TopologyImageLoader *>(getModuleByPath(imagePath));
+            if (!topologyImage)
+                throw cRuntimeError("Module '%s' is not an insotu TopologyImageLoader", imagePath);
+        }
     }
     else if (stage == inet::INITSTAGE_ROUTING_PROTOCOLS) {
+        readSrlgConfig(par("srlgConfig").xmlValue());
         buildTunnelPlan();
         syncActiveIndices();
 
+        if (tedInvalidation) {
+            tedLinkState.assign(tedmod->ted.size(), true);
+            for (size_t i = 0; i < tedmod->ted.size(); i++)
+                tedLinkState[i] = tedmod->ted[i].state;
+            tedmod->subscribe(inet::tedChangedSignal, this);
+        }
+
         for (auto& session : traffic) {
             for (auto& path : session.paths) {
                 if (path.permanent) {
@@ -49,7 +131,7 @@ void RsvpTeScriptable::initialize(int stage)
                     if (!hasPsb) {
                         EV_INFO << "Pre-establishing backup LSP " << path.sender.Lsp_Id
                                 << " for tunnel " << session.sobj.Tunnel_Id << endl;
-                        createPath(session.sobj, path.sender);
+                        requestPathSetup(session.sobj.Tunnel_Id, path.sender.Lsp_Id, SIGNALLING_SETUP);
                     }
                 }
             }
@@ -59,6 +141,12 @@ void RsvpTeScriptable::initialize(int stage)
         // Only explicit rebinding via switchToIndex() will update FECs
         EV_INFO << "Initial LSP setup complete, disabling automatic FEC binding" << endl;
         classifierExt->setAllowAutomaticBinding(false);
+
+        if (autoBandwidth) {
+            autoBandwidthSampleTime = simTime();
+            autoBandwidthAdjustTime = simTime() + autoBandwidthInterval;
+            scheduleAt(simTime() + autoBandwidthSampleInterval, autoBandwidthTimer);
+        }
     }
 }
 
@@ -70,6 +158,24 @@ void RsvpTeScriptable::handleMessageWhenUp(cMessage *msg)
         return;
     }
 
+    if (msg == signallingTimer) {
+        dispatchSignalling();
+        return;
+    }
+
+    if (msg == autoBandwidthTimer) {
+        sampleTunnelRates();
+        if (simTime() >= autoBandwidthAdjustTime) {
+            adjustBandwidth();
+            autoBandwidthAdjustTime = simTime() + autoBandwidthInterval;
+        }
+        scheduleAt(simTime() + autoBandwidthSampleInterval, autoBandwidthTimer);
+        return;
+    }
+
+    if (handleNeighbourRefreshTimer(msg))
+        return;
+
     // Filter out non-RSVP packets (e.g., ICMP messages)
     if (auto packet = dynamic_cast<inet::Packet *>(msg)) {
         // Check if packet contains ICMP header
@@ -86,11 +192,20 @@ void RsvpTeScriptable::handleMessageWhenUp(cMessage *msg)
         // Check if packet actually contains RSVP message
         try {
             auto chunk = packet->peekAtFront<inet::Chunk>();
-            if (!dynamicPtrCast<const inet::RsvpMessage>(chunk)) {
+            auto rsvpMessage = dynamicPtrCast<const inet::RsvpMessage>(chunk);
+            if (!rsvpMessage) {
                 EV_WARN << "Received non-RSVP packet with protocol tag, discarding" << endl;
                 delete msg;
                 return;
             }
+            if (rsvpMessage->getRsvpKind() == SREFRESH_MESSAGE) {
+                processSummaryRefresh(packet);
+                return;
+            }
+            if (rsvpMessage->getRsvpKind() == SLA_NOTIFY_MESSAGE) {
+                processSlaNotify(packet);
+                return;
+            }
         }
         catch (const std::exception& e) {
             EV_WARN << "Exception while checking packet type: " << e.what() << ", discarding" << endl;
@@ -112,57 +227,850 @@ void RsvpTeScriptable::processCommand(const cXMLElement& node)
     if (!strcmp(name, "reroute")) {
         const char *args = node.getAttribute("args");
         if (!args)
-            throw cRuntimeError("reroute command requires args (tunnelId[=<id>] [action=restore])");
+            throw cRuntimeError("reroute command requires args (tunnelId=<id> | tunnels=<list> | node=<router> | link=<router>-<router> [action=restore])");
 
-        int tunnelId = -1;
+        // Selectors are combined; all tunnels are resolved before any is moved
+        std::set<int> tunnels;
+        bool selected = false;
         bool restore = false;
 
         cStringTokenizer tokenizer(args, " ");
         while (const char *token = tokenizer.nextToken()) {
-            if (!strncmp(token, "tunnelId=", 9))
-                tunnelId = atoi(token + 9);
+            if (!strncmp(token, "tunnelId=", 9)) {
+                int tunnelId = atoi(token + 9);
+                if (tunnelId < 0)
+                    throw cRuntimeError("reroute command requires a valid tunnelId argument");
+                tunnels.insert(tunnelId);
+                selected = true;
+            }
+            else if (!strncmp(token, "tunnels=", 8)) {
+                parseTunnelList(token + 8, tunnels);
+                selected = true;
+            }
+            else if (!strncmp(token, "node=", 5)) {
+                collectTunnelsVia(resolveRouter(token + 5), inet::Ipv4Address(), false, tunnels);
+                selected = true;
+            }
+            else if (!strncmp(token, "link=", 5)) {
+                const char *sep = strchr(token + 5, '-');
+                if (!sep)
+                    throw cRuntimeError("reroute link argument must be <router>-<router>: %s", token);
+                std::string from(token + 5, sep - (token + 5));
+                collectTunnelsVia(resolveRouter(from.c_str()), resolveRouter(sep + 1), false, tunnels);
+                selected = true;
+            }
             else if (!strcmp(token, "restore=true") || !strcmp(token, "action=restore"))
                 restore = true;
         }
 
-        if (tunnelId < 0)
-            throw cRuntimeError("reroute command requires tunnelId argument");
+        if (!selected)
+            throw cRuntimeError("reroute command requires tunnelId, tunnels, node or link argument");
 
-        EV_INFO << "Scenario command: reroute tunnelId=" << tunnelId
-                << (restore ? " action=restore" : " action=failover") << endl;
+        EV_INFO << "Scenario command: reroute " << tunnels.size() << " tunnel(s) ["
+                << args << "]" << (restore ? " action=restore" : " action=failover") << endl;
 
-        if (restore)
-            requestRestore(tunnelId, "scenario command", false);
-        else
-            requestFailover(tunnelId, "scenario command", false);
+        applyBulkReroute(tunnels, restore, "scenario command");
+    }
+    else if (!strcmp(name, "drain")) {
+        const char *args = node.getAttribute("args");
+        if (!args)
+            throw cRuntimeError("drain command requires args (node=<router> [action=restore])");
+
+        inet::Ipv4Address router;
+        bool restore = false;
+
+        cStringTokenizer tokenizer(args, " ");
+        while (const char *token = tokenizer.nextToken()) {
+            if (!strncmp(token, "node=", 5))
+                router = resolveRouter(token + 5);
+            else if (!strcmp(token, "restore=true") || !strcmp(token, "action=restore"))
+                restore = true;
+        }
+
+        if (router.isUnspecified())
+            throw cRuntimeError("drain command requires node argument");
+
+        // A drained router is avoided by failover and restoration until undrained
+        std::set<int> tunnels;
+        if (!restore) {
+            drainedNodes.insert(router);
+            collectTunnelsVia(router, inet::Ipv4Address(), false, tunnels);
+        }
+        else {
+            drainedNodes.erase(router);
+            collectTunnelsVia(router, inet::Ipv4Address(), true, tunnels);
+        }
+
+        EV_INFO << "Scenario command: " << (restore ? "undrain " : "drain ") << router
+                << ", " << tunnels.size() << " tunnel(s) affected" << endl;
+
+        applyBulkReroute(tunnels, restore, "scenario command");
+    }
+    else if (!strcmp(name, "dump-flight-recorder")) {
+        const char *file = node.getAttribute("file");
+        dumpFlightRecorder(file ? file : flightRecorderFile.c_str());
     }
     else {
         throw cRuntimeError("Unknown ScenarioManager command: %s", name);
     }
 }
 
+inet::Ipv4Address RsvpTeScriptable::resolveRouter(const char *address) const
+{
+    // Module names resolve to an interface address; the route index uses router IDs
+    return toRouterId(inet::L3AddressResolver().resolve(address).toIpv4());
+}
+
+inet::Ipv4Address RsvpTeScriptable::toRouterId(inet::Ipv4Address address) const
+{
+    // ERO hops may name interface addresses; map them to the owning router
+    for (const auto& link : tedmod->ted) {
+        if (link.advrouter == address)
+            return address;
+        if (link.local == address)
+            return link.advrouter;
+        if (link.remote == address)
+            return link.linkid;
+    }
+    return address;
+}
+
+void RsvpTeScriptable::buildRouteIndex()
+{
+    lspRoutes.clear();
+    nodeLspIndex.clear();
+    linkLspIndex.clear();
+
+    for (const auto& elem : tunnelLspOrder) {
+        traffic_session_t *session = findSessionByTunnel(elem.first);
+        if (!session)
+            continue;
+
+        for (int lspId : elem.second) {
+            traffic_path_t *path = findPathByLsp(session, lspId);
+            inet::PathStateBlock *psb = path ? findPSB(session->sobj, path->sender) : nullptr;
+            if (!psb || psb->OutInterface.isUnspecified())
+                continue;
+
+            // This router, the first hop by outgoing interface, then the remaining
+            // explicit route; loose segments and the part beyond the ERO (routed
+            // hop by hop) are filled in from the TED
+            std::vector<inet::Ipv4Address>& route = lspRoutes[{elem.first, lspId}];
+            route.push_back(routerId);
+            route.push_back(tedmod->getPeerByLocalAddress(psb->OutInterface));
+            bool complete = true;
+            for (const auto& hop : psb->ERO) {
+                inet::Ipv4Address router = toRouterId(hop.node);
+                if (router == route.back())
+                    continue;
+                if (hop.L && complete)
+                    complete = completeRoute(route, router);
+                if (router != route.back())
+                    route.push_back(router);
+            }
+            inet::Ipv4Address egress = toRouterId(session->sobj.DestAddress);
+            if (complete && route.back() != egress)
+                complete = completeRoute(route, egress);
+            if (!complete)
+                EV_WARN << "Route of LSP " << lspId << " of tunnel " << elem.first << " is incomplete (no TED path beyond "
+                        << route.back() << "); link and node matching may miss it" << endl;
+
+            for (const auto& router : route)
+                nodeLspIndex[router].insert({elem.first, lspId});
+            for (size_t i = 1; i < route.size(); i++)
+                linkLspIndex[linkKey(route[i - 1], route[i])].insert({elem.first, lspId});
+        }
+    }
+
+    routeIndexValid = true;
+}
+
+bool RsvpTeScriptable::completeRoute(std::vector<inet::Ipv4Address>& route, inet::Ipv4Address target) const
+{
+    // Lowest metric path over all TED links (the LSP was signalled before any
+    // of them failed); appends the hops between route.back() and target
+    inet::Ipv4Address source = route.back();
+    std::map<inet::Ipv4Address, double> dist = {{source, 0}};
+    std::map<inet::Ipv4Address, inet::Ipv4Address> previous;
+    std::set<inet::Ipv4Address> done;
+    while (true) {
+        inet::Ipv4Address node;
+        double nodeDist = INFINITY;
+        for (const auto& elem : dist) {
+            if (!done.count(elem.first) && elem.second < nodeDist) {
+                node = elem.first;
+                nodeDist = elem.second;
+            }
+        }
+        if (std::isinf(nodeDist))
+            return false;
+        if (node == target)
+            break;
+        done.insert(node);
+        for (const auto& link : tedmod->ted) {
+            if (link.advrouter != node || done.count(link.linkid))
+                continue;
+            auto it = dist.find(link.linkid);
+            if (it == dist.end() || nodeDist + link.metric < it->second) {
+                dist[link.linkid] = nodeDist + link.metric;
+                previous[link.linkid] = node;
+            }
+        }
+    }
+
+    std::vector<inet::Ipv4Address> hops;
+    for (inet::Ipv4Address node = target; node != source; node = previous[node])
+        hops.push_back(node);
+    route.insert(route.end(), hops.rbegin(), hops.rend());
+    return true;
+}
+
+bool RsvpTeScriptable::traversesDrainedNode(int tunnelId, int lspId)
+{
+    if (drainedNodes.empty())
+        return false;
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto it = lspRoutes.find({tunnelId, lspId});
+    if (it != lspRoutes.end()) {
+        for (const auto& router : it->second) {
+            if (drainedNodes.count(router))
+                return true;
+        }
+        return false;
+    }
+
+    // Not signalled (no PSB), so not in the index: check the configured ERO.
+    // Hops left to CSPF are not known before signalling
+    traffic_path_t *path = findPathByLsp(findSessionByTunnel(tunnelId), lspId);
+    if (!path)
+        return false;
+    for (const auto& hop : path->ERO) {
+        if (drainedNodes.count(toRouterId(hop.node)))
+            return true;
+    }
+    return false;
+}
+
+std::pair<inet::Ipv4Address, inet::Ipv4Address> RsvpTeScriptable::linkKey(inet::Ipv4Address a, inet::Ipv4Address b)
+{
+    return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+}
+
+void RsvpTeScriptable::collectLspsOnLink(inet::Ipv4Address a, inet::Ipv4Address b, std::set<std::pair<int, int>>& lsps)
+{
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto it = linkLspIndex.find(linkKey(a, b));
+    if (it != linkLspIndex.end())
+        lsps.insert(it->second.begin(), it->second.end());
+}
+
+bool RsvpTeScriptable::crossesDownLink(int tunnelId, int lspId)
+{
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto it = lspRoutes.find({tunnelId, lspId});
+    if (it == lspRoutes.end())
+        return false;
+
+    const std::vector<inet::Ipv4Address>& route = it->second;
+    for (size_t i = 1; i < route.size(); i++) {
+        for (const auto& link : tedmod->ted) {
+            if (!link.state && linkKey(link.advrouter, link.linkid) == linkKey(route[i - 1], route[i]))
+                return true;
+        }
+    }
+    return false;
+}
+
+void RsvpTeScriptable::receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details)
+{
+    Enter_Method("receiveSignal");
+
+    if (signalID != inet::tedChangedSignal)
+        return;
+
+    const auto *change = check_and_cast<const inet::TedChangeInfo *>(obj);
+    if (tedLinkState.size() < tedmod->ted.size())
+        tedLinkState.resize(tedmod->ted.size(), true);
+
+    std::set<std::pair<int, int>> failed;
+    std::set<std::pair<int, int>> recovered;
+    for (size_t i = 0; i < change->getTedLinkIndicesArraySize(); i++) {
+        unsigned int index = change->getTedLinkIndices(i);
+        if (index >= tedmod->ted.size())
+            continue;
+        const auto& link = tedmod->ted[index];
+        if (link.state == tedLinkState[index])
+            continue;
+        tedLinkState[index] = link.state;
+
+        EV_INFO << "TED reports link " << link.advrouter << " -> " << link.linkid << (link.state ? " up" : " down") << endl;
+        collectLspsOnLink(link.advrouter, link.linkid, link.state ? recovered : failed);
+    }
+
+    if (!failed.empty())
+        invalidateLsps(failed);
+    if (!recovered.empty())
+        revalidateLsps(recovered);
+}
+
+void RsvpTeScriptable::invalidateLsps(const std::set<std::pair<int, int>>& lsps)
+{
+    // Mark the whole batch first, so no failover picks another LSP of the batch
+    std::vector<std::pair<int, int>> invalidated;
+    for (const auto& lsp : lsps) {
+        if (tedFailedLsps.insert(lsp).second)
+            invalidated.push_back(lsp);
+    }
+    if (invalidated.empty())
+        return;
+
+    EV_WARN << "TED link down: invalidating " << invalidated.size() << " LSP(s) ahead of RSVP error signalling" << endl;
+    numTedInvalidations += invalidated.size();
+    for (const auto& lsp : invalidated)
+        handlePathFailure(lsp.first, lsp.second, "TED", true);
+}
+
+void RsvpTeScriptable::revalidateLsps(const std::set<std::pair<int, int>>& lsps)
+{
+    // LSPs that survived the outage (no PATH_NOTIFY came) are usable again
+    // once none of their links is down
+    for (const auto& lsp : lsps) {
+        if (!tedFailedLsps.count(lsp) || crossesDownLink(lsp.first, lsp.second))
+            continue;
+        tedFailedLsps.erase(lsp);
+        EV_INFO << "TED link up: LSP " << lsp.second << " of tunnel " << lsp.first << " usable again" << endl;
+        handlePathRestored(lsp.first, lsp.second, "TED");
+    }
+}
+
+void RsvpTeScriptable::parseTunnelList(const char *list, std::set<int>& tunnels) const
+{
+    // Comma-separated tunnel IDs and ranges ("1-100,205"), or "all"
+    cStringTokenizer tokenizer(list, ",");
+    while (const char *token = tokenizer.nextToken()) {
+        if (!strcmp(token, "all")) {
+            for (const auto& elem : tunnelLspOrder)
+                tunnels.insert(elem.first);
+            continue;
+        }
+
+        char *end = nullptr;
+        long first = strtol(token, &end, 10);
+        long last = first;
+        if (end != token && *end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (end == token || *end || first < 0 || last < first)
+            throw cRuntimeError("Invalid tunnel list entry '%s'", token);
+
+        // Ranges only select tunnels that are actually configured
+        for (auto it = tunnelLspOrder.lower_bound(first); it != tunnelLspOrder.end() && it->first <= last; ++it)
+            tunnels.insert(it->first);
+    }
+}
+
+void RsvpTeScriptable::collectTunnelsVia(inet::Ipv4Address node, inet::Ipv4Address peer, bool primaryLsp, std::set<int>& tunnels)
+{
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    // A selector naming nothing on a known route is most likely a typo or a
+    // hop the route index could not resolve; say so instead of matching nothing silently
+    auto indexIt = nodeLspIndex.find(node);
+    if (indexIt == nodeLspIndex.end()) {
+        EV_WARN << "Router " << node << " is not on the route of any signalled LSP, no tunnels selected" << endl;
+        return;
+    }
+    if (!peer.isUnspecified() && !linkLspIndex.count(linkKey(node, peer))) {
+        EV_WARN << "Link " << node << "-" << peer << " is not on the route of any signalled LSP, no tunnels selected" << endl;
+        return;
+    }
+
+    for (const auto& lsp : indexIt->second) {
+        int tunnelId = lsp.first;
+        int lspId = primaryLsp ? tunnelLspOrder[tunnelId][getPrimaryIndex(tunnelId)] : getActiveLspId(tunnelId);
+        if (lsp.second != lspId)
+            continue;
+
+        if (!peer.isUnspecified()) {
+            // Link given: node and peer must be adjacent on the route, in either direction
+            const std::vector<inet::Ipv4Address>& route = lspRoutes[lsp];
+            bool onLink = false;
+            for (size_t i = 1; i < route.size() && !onLink; i++)
+                onLink = (route[i - 1] == node && route[i] == peer) || (route[i - 1] == peer && route[i] == node);
+            if (!onLink)
+                continue;
+        }
+        tunnels.insert(tunnelId);
+    }
+}
+
+void RsvpTeScriptable::applyBulkReroute(const std::set<int>& tunnels, bool restore, const char *reason)
+{
+    for (int tunnelId : tunnels) {
+        if (restore)
+            requestRestore(tunnelId, reason, false);
+        else
+            requestFailover(tunnelId, reason, false);
+    }
+}
+
 void RsvpTeScriptable::processPATH_NOTIFY(PathNotifyMsg *msg)
 {
     int status = msg->getStatus();
     SessionObj session = msg->getSession();
     SenderTemplateObj sender = msg->getSender();
 
+    // INET retries a failed setup by calling createPath() directly, which
+    // would bypass the pacing; queue the retry like any other setup instead
+    if (status == inet::PATH_RETRY && signallingPacing) {
+        bool active = getActiveLspId(session.Tunnel_Id) == sender.Lsp_Id;
+        requestPathSetup(session.Tunnel_Id, sender.Lsp_Id, active ? SIGNALLING_RESTORATION : SIGNALLING_SETUP);
+        delete msg;
+        return;
+    }
+
     inet::RsvpTe::processPATH_NOTIFY(msg);
 
     switch (status) {
         case inet::PATH_FAILED:
         case inet::PATH_UNFEASIBLE:
         case inet::PATH_PREEMPTED:
-            handlePathFailure(session.Tunnel_Id, sender.Lsp_Id, "PATH_NOTIFY");
+            if (tedFailedLsps.erase({session.Tunnel_Id, sender.Lsp_Id})) {
+                EV_DETAIL << "LSP " << sender.Lsp_Id << " of tunnel " << session.Tunnel_Id
+                          << " already failed over on the TED update" << endl;
+                break;
+            }
+            if (!handleResizeEvent(session.Tunnel_Id, sender.Lsp_Id, true))
+                handlePathFailure(session.Tunnel_Id, sender.Lsp_Id, "PATH_NOTIFY", status == inet::PATH_FAILED);
             break;
         case inet::PATH_CREATED:
-            handlePathRestored(session.Tunnel_Id, sender.Lsp_Id, "PATH_NOTIFY");
+            tedFailedLsps.erase({session.Tunnel_Id, sender.Lsp_Id});
+            if (!handleResizeEvent(session.Tunnel_Id, sender.Lsp_Id, false))
+                handlePathRestored(session.Tunnel_Id, sender.Lsp_Id, "PATH_NOTIFY");
             break;
         default:
             break;
     }
 }
 
+void RsvpTeScriptable::processPSB_TIMER(inet::PsbTimerMsg *msg)
+{
+    inet::PathStateBlock *psb = refreshReduction ? findPsbById(msg->getId()) : nullptr;
+    if (!psb || psb->OutInterface.isUnspecified()) {
+        inet::RsvpTe::processPSB_TIMER(msg);
+        return;
+    }
+
+    // Full PATH now (initial or triggered), then covered by the neighbour's
+    // summary refresh; the per-PSB refresh timer is not rescheduled
+    refreshPath(psb);
+    inet::Ipv4Address neighbour = tedmod->getPeerByLocalAddress(psb->OutInterface);
+    getNeighbourRefresh(neighbour).psbIds.insert(psb->id);
+}
+
+void RsvpTeScriptable::processRSB_REFRESH_TIMER(inet::RsbRefreshTimerMsg *msg)
+{
+    inet::ResvStateBlock *rsb = refreshReduction ? findRsbById(msg->getId()) : nullptr;
+    if (!rsb || rsb->commitTimerMsg->isScheduled()) {
+        inet::RsvpTe::processRSB_REFRESH_TIMER(msg);
+        return;
+    }
+
+    refreshResv(rsb);
+
+    // Register the RSB with every upstream neighbour refreshResv() sent to
+    for (auto& psb : PSBList) {
+        if (psb.OutInterface != rsb->OI || tedmod->isLocalAddress(psb.Previous_Hop_Address))
+            continue;
+        for (auto& flow : rsb->FlowDescriptor) {
+            if ((inet::FilterSpecObj&)psb.Sender_Template_Object == flow.Filter_Spec_Object) {
+                getNeighbourRefresh(psb.Previous_Hop_Address).rsbIds.insert(rsb->id);
+                break;
+            }
+        }
+    }
+}
+
+RsvpTeScriptable::NeighbourRefresh& RsvpTeScriptable::getNeighbourRefresh(inet::Ipv4Address neighbour)
+{
+    NeighbourRefresh& state = neighbourRefresh[neighbour];
+    if (!state.timer)
+        state.timer = new cMessage(("summaryRefresh-" + neighbour.str()).c_str());
+    if (!state.timer->isScheduled())
+        scheduleAfter(summaryRefreshInterval, state.timer);
+    return state;
+}
+
+bool RsvpTeScriptable::handleNeighbourRefreshTimer(cMessage *msg)
+{
+    for (auto& elem : neighbourRefresh) {
+        if (elem.second.timer != msg)
+            continue;
+
+        sendSummaryRefresh(elem.first, elem.second);
+        if (!elem.second.psbIds.empty() || !elem.second.rsbIds.empty())
+            scheduleAfter(summaryRefreshInterval, msg);
+        return true;
+    }
+    return false;
+}
+
+void RsvpTeScriptable::sendSummaryRefresh(inet::Ipv4Address neighbour, NeighbourRefresh& state)
+{
+    auto srefresh = inet::makeShared<RsvpSrefreshMsg>();
+    srefresh->setNack(false);
+
+    // PATH states sent downstream to this neighbour; removed PSBs are dropped
+    for (auto it = state.psbIds.begin(); it != state.psbIds.end();) {
+        inet::PathStateBlock *psb = findPsbById(*it);
+        if (!psb || psb->OutInterface.isUnspecified() || tedmod->getPeerByLocalAddress(psb->OutInterface) != neighbour) {
+            it = state.psbIds.erase(it);
+            continue;
+        }
+        SrefreshEntry entry;
+        entry.kind = SREFRESH_PATH_STATE;
+        entry.messageId = psb->id;
+        entry.session = psb->Session_Object;
+        entry.sender = psb->Sender_Template_Object;
+        srefresh->appendEntries(entry);
+        ++it;
+    }
+
+    // RESV states sent upstream to this neighbour, one entry per sender
+    for (auto it = state.rsbIds.begin(); it != state.rsbIds.end();) {
+        inet::ResvStateBlock *rsb = findRsbById(*it);
+        if (!rsb) {
+            it = state.rsbIds.erase(it);
+            continue;
+        }
+        for (auto& psb : PSBList) {
+            if (psb.OutInterface != rsb->OI || psb.Previous_Hop_Address != neighbour)
+                continue;
+            for (auto& flow : rsb->FlowDescriptor) {
+                if ((inet::FilterSpecObj&)psb.Sender_Template_Object != flow.Filter_Spec_Object)
+                    continue;
+                SrefreshEntry entry;
+                entry.kind = SREFRESH_RESV_STATE;
+                entry.messageId = rsb->id;
+                entry.session = rsb->Session_Object;
+                entry.sender = psb.Sender_Template_Object;
+                srefresh->appendEntries(entry);
+            }
+        }
+        ++it;
+    }
+
+    size_t numEntries = srefresh->getEntriesArraySize();
+    if (numEntries == 0)
+        return;
+
+    // Common header + MESSAGE_ID_LIST object with one 4-byte id per state
+    srefresh->setChunkLength(inet::B(8 + 8 + 4 * numEntries));
+    auto packet = new inet::Packet("Srefresh");
+    packet->insertAtFront(srefresh);
+
+    EV_DETAIL << "Sending summary refresh of " << numEntries << " states to " << neighbour << endl;
+    numSummaryRefreshesSent++;
+    numSummaryEntriesSent += numEntries;
+    sendToIP(packet, neighbour);
+}
+
+void RsvpTeScriptable::processSummaryRefresh(inet::Packet *packet)
+{
+    const auto& srefresh = packet->peekAtFront<RsvpSrefreshMsg>();
+    inet::Ipv4Address sender = packet->getTag<inet::L3AddressInd>()->getSrcAddress().toIpv4();
+
+    if (srefresh->getNack()) {
+        // Neighbour lost these states: refresh them with full messages
+        for (size_t i = 0; i < srefresh->getEntriesArraySize(); i++) {
+            const SrefreshEntry& entry = srefresh->getEntries(i);
+            if (entry.kind == SREFRESH_PATH_STATE) {
+                if (inet::PathStateBlock *psb = findPsbById(entry.messageId))
+                    refreshPath(psb);
+            }
+            else if (inet::ResvStateBlock *rsb = findRsbById(entry.messageId))
+                refreshResv(rsb, sender);
+        }
+        delete packet;
+        return;
+    }
+
+    auto nack = inet::makeShared<RsvpSrefreshMsg>();
+    nack->setNack(true);
+    for (size_t i = 0; i < srefresh->getEntriesArraySize(); i++) {
+        const SrefreshEntry& entry = srefresh->getEntries(i);
+        if (entry.kind == SREFRESH_PATH_STATE) {
+            if (inet::PathStateBlock *psb = findPSB(entry.session, entry.sender)) {
+                scheduleTimeout(psb);
+                continue;
+            }
+        }
+        else {
+            unsigned int index;
+            if (inet::ResvStateBlock *rsb = findRSB(entry.session, entry.sender, index)) {
+                scheduleTimeout(rsb);
+                continue;
+            }
+        }
+        nack->appendEntries(entry);
+    }
+    delete packet;
+
+    size_t numUnknown = nack->getEntriesArraySize();
+    if (numUnknown == 0)
+        return;
+
+    EV_INFO << "Summary refresh from " << sender << " lists " << numUnknown << " unknown states, sending NACK" << endl;
+    nack->setChunkLength(inet::B(8 + 8 + 4 * numUnknown));
+    auto nackPacket = new inet::Packet("SrefreshNack");
+    nackPacket->insertAtFront(nack);
+    numRefreshNacksSent++;
+    sendToIP(nackPacket, sender);
+}
+
+void RsvpTeScriptable::collectEgressLabels(std::map<int, std::pair<int, int>>& labelLsps)
+{
+    Enter_Method_Silent("collectEgressLabels");
+
+    labelLsps.clear();
+    for (auto& rsb : RSBList) {
+        if (rsb.Session_Object.DestAddress != routerId)
+            continue;
+        for (size_t i = 0; i < rsb.FlowDescriptor.size() && i < rsb.inLabelVector.size(); i++) {
+            if (rsb.inLabelVector[i] >= 0)
+                labelLsps[rsb.inLabelVector[i]] = { rsb.Session_Object.Tunnel_Id, rsb.FlowDescriptor[i].Filter_Spec_Object.Lsp_Id };
+        }
+    }
+}
+
+void RsvpTeScriptable::sendSlaNotify(int tunnelId, bool violated, const char *source)
+{
+    Enter_Method("sendSlaNotify");
+
+    // One notify per headend with an LSP of the tunnel ending here
+    std::set<inet::Ipv4Address> headends;
+    for (auto& psb : PSBList) {
+        if (psb.Session_Object.Tunnel_Id != tunnelId || psb.Session_Object.DestAddress != routerId)
+            continue;
+        inet::Ipv4Address headend = psb.Sender_Template_Object.SrcAddress;
+        if (!headends.insert(headend).second)
+            continue;
+
+        auto notify = inet::makeShared<RsvpSlaNotifyMsg>();
+        notify->setSession(psb.Session_Object);
+        notify->setSender(psb.Sender_Template_Object);
+        notify->setViolated(violated);
+        notify->setSource(source);
+        // Common header + SESSION, ERROR_SPEC and SENDER_TEMPLATE objects
+        notify->setChunkLength(inet::B(8 + 16 + 12 + 12));
+        auto packet = new inet::Packet(violated ? "SlaViolated" : "SlaCleared");
+        packet->insertAtFront(notify);
+
+        EV_INFO << "Sending SLA " << (violated ? "violation" : "clear") << " notify for tunnel "
+                << tunnelId << " to headend " << headend << endl;
+        sendToIP(packet, headend);
+    }
+
+    if (headends.empty())
+        EV_WARN << "No LSP of tunnel " << tunnelId << " ends at this router, SLA notify not sent" << endl;
+}
+
+void RsvpTeScriptable::processSlaNotify(inet::Packet *packet)
+{
+    const auto& notify = packet->peekAtFront<RsvpSlaNotifyMsg>();
+    int tunnelId = notify->getSession().Tunnel_Id;
+    bool violated = notify->getViolated();
+    std::string source = notify->getSource();
+    delete packet;
+
+    if (tunnelLspOrder.find(tunnelId) == tunnelLspOrder.end()) {
+        EV_WARN << "SLA notify for unknown tunnel " << tunnelId << ", ignoring" << endl;
+        return;
+    }
+
+    EV_INFO << "SLA " << (violated ? "violation" : "clear") << " reported by egress for tunnel "
+            << tunnelId << " (" << source << ")" << endl;
+    handleCongestionNotification(tunnelId, violated, source.c_str());
+}
+
+void RsvpTeScriptable::recordDecision(int tunnelId, int lspId, int label, int fromIndex, int toIndex, FlightRecorder::Event event, const char *reason)
+{
+    flightRecorder.record(simTime().raw(), tunnelId, lspId, label, fromIndex, toIndex, event, FlightRecorder::classifyReason(reason));
+}
+
+void RsvpTeScriptable::dumpFlightRecorder(const char *filename)
+{
+    if (flightRecorder.getCapacity() == 0)
+        return;
+
+    std::string file = filename ? filename : "";
+    if (file.empty()) {
+        cConfigurationEx *cfg = getEnvir()->getConfigEx();
+        file = std::string(cfg->getVariable(CFGVAR_RESULTDIR)) + "/" + cfg->getVariable(CFGVAR_CONFIGNAME) + "-"
+               + cfg->getVariable(CFGVAR_RUNNUMBER) + "-" + getParentModule()->getFullName() + ".flrc";
+    }
+
+    // Called from finish(): a diagnostics dump must not abort the run's result recording
+    std::error_code error;
+    std::filesystem::path dir = std::filesystem::path(file).parent_path();
+    if (!dir.empty())
+        std::filesystem::create_directories(dir, error);
+    if (error || !flightRecorder.dump(file.c_str(), SimTime::getScaleExp())) {
+        EV_WARN << "Cannot write flight recorder dump '" << file << "'"
+                << (error ? ": " + error.message() : std::string()) << endl;
+        return;
+    }
+    EV_INFO << "Flight recorder: " << flightRecorder.getCount() << " of " << flightRecorder.getTotal()
+            << " decisions written to " << file << endl;
+}
+
+void RsvpTeScriptable::finish()
+{
+    if (flightRecorder.getTotal() > 0)
+        dumpFlightRecorder(flightRecorderFile.c_str());
+
+    recordScalar("pathSwitches", numSwitches);
+    recordScalar("noAlternatePath", numNoAlternate);
+    if (tedInvalidation)
+        recordScalar("tedInvalidations", numTedInvalidations);
+    if (autoBandwidth) {
+        recordScalar("lspResizes", numResizes);
+        recordScalar("lspResizeFailures", numResizeFailures);
+    }
+    cancelAndDelete(autoBandwidthTimer);
+    autoBandwidthTimer = nullptr;
+
+    if (refreshReduction) {
+        recordScalar("summaryRefreshesSent", numSummaryRefreshesSent);
+        recordScalar("summaryRefreshEntries", numSummaryEntriesSent);
+        recordScalar("summaryRefreshNacksSent", numRefreshNacksSent);
+    }
+    for (auto& elem : neighbourRefresh) {
+        cancelAndDelete(elem.second.timer);
+        elem.second.timer = nullptr;
+    }
+    cancelAndDelete(signallingTimer);
+    signallingTimer = nullptr;
+    inet::RsvpTe::finish();
+}
+
+void RsvpTeScriptable::readTrafficFromXML(const cXMLElement *sessions)
+{
+    inet::RsvpTe::readTrafficFromXML(sessions);
+
+    const TopologyImage *image = topologyImage ? topologyImage->getImage() : nullptr;
+    const TopologyImage::Router *router = image ? topologyImage->findRouter(this) : nullptr;
+    if (!router || router->numSessions == 0)
+        return;
+    if (!traffic.empty())
+        throw cRuntimeError("Traffic sessions are configured both in the traffic parameter and in the topology image");
+
+    // Same state as readTrafficSessionFromXML() builds, with endpoints already resolved
+    for (const auto& storedSession : image->getSessions(*router)) {
+        traffic_session_t session;
+        session.sobj.DestAddress = inet::Ipv4Address(storedSession.destAddress);
+        session.sobj.Tunnel_Id = storedSession.tunnelId;
+        session.sobj.Extended_Tunnel_Id = storedSession.extendedTunnelId;
+        session.sobj.setupPri = storedSession.setupPri;
+        session.sobj.holdingPri = storedSession.holdingPri;
+
+        for (const auto& storedPath : image->getPaths(storedSession)) {
+            traffic_path_t path;
+            path.sender.SrcAddress = inet::Ipv4Address(storedPath.srcAddress);
+            path.sender.Lsp_Id = storedPath.lspId;
+            path.tspec.req_bandwidth = storedPath.bandwidth;
+            path.max_delay = SimTime::fromRaw(storedPath.maxDelay);
+            path.owner = storedPath.owner;
+            path.permanent = storedPath.permanent != 0;
+            path.color = storedPath.color;
+            for (const auto& hop : image->getHops(storedPath)) {
+                inet::EroObj ero;
+                ero.L = hop.loose != 0;
+                ero.node = inet::Ipv4Address(hop.node);
+                path.ERO.push_back(ero);
+            }
+            session.paths.push_back(path);
+        }
+
+        traffic.push_back(session);
+        for (const auto& path : traffic.back().paths)
+            createPath(traffic.back().sobj, path.sender);
+    }
+
+    EV_INFO << "Loaded " << router->numSessions << " traffic session(s) from topology image" << endl;
+}
+
+void RsvpTeScriptable::storeTraffic(TopologyImage::Builder& builder) const
+{
+    for (const auto& session : traffic) {
+        builder.addSession(session.sobj.DestAddress.getInt(), session.sobj.Tunnel_Id, session.sobj.Extended_Tunnel_Id,
+                session.sobj.setupPri, session.sobj.holdingPri);
+        for (const auto& path : session.paths) {
+            std::vector<TopologyImage::Hop> route;
+            for (const auto& ero : path.ERO)
+                route.push_back({ ero.node.getInt(), ero.L ? 1u : 0u });
+            builder.addPath(path.sender.SrcAddress.getInt(), path.sender.Lsp_Id, path.tspec.req_bandwidth, path.max_delay.raw(),
+                    path.owner, path.color, path.permanent, route);
+        }
+    }
+}
+
+void RsvpTeScriptable::readSrlgConfig(const cXMLElement *config)
+{
+    lspSrlgs.clear();
+    failedSrlgs.clear();
+
+    if (!config)
+        return;
+
+    for (cXMLElement *srlgElem : config->getChildrenByTagName("srlg")) {
+        const char *idAttr = srlgElem->getAttribute("id");
+        if (!idAttr)
+            throw cRuntimeError("SRLG entry missing 'id' attribute at %s", srlgElem->getSourceLocation());
+        int srlgId = atoi(idAttr);
+
+        // Explicit LSP membership
+        for (cXMLElement *lspElem : srlgElem->getChildrenByTagName("lsp")) {
+            const char *tunnelAttr = lspElem->getAttribute("tunnel");
+            const char *lspAttr = lspElem->getAttribute("lspid");
+            if (!tunnelAttr || !lspAttr)
+                throw cRuntimeError("SRLG lsp entry requires 'tunnel' and 'lspid' attributes at %s", lspElem->getSourceLocation());
+            lspSrlgs[std::make_pair(atoi(tunnelAttr), atoi(lspAttr))].insert(srlgId);
+        }
+
+        // Link membership, matched against the hops of each configured ERO
+        for (cXMLElement *linkElem : srlgElem->getChildrenByTagName("link")) {
+            const char *fromAttr = linkElem->getAttribute("from");
+            const char *toAttr = linkElem->getAttribute("to");
+            if (!fromAttr || !toAttr)
+                throw cRuntimeError("SRLG link entry requires 'from' and 'to' attributes at %s", linkElem->getSourceLocation());
+            inet::Ipv4Address from(fromAttr);
+            inet::Ipv4Address to(toAttr);
+
+            for (const auto& session : traffic) {
+                for (const auto& path : session.paths) {
+                    inet::Ipv4Address prev = routerId;
+                    for (const auto& hop : path.ERO) {
+                        if ((prev == from && hop.node == to) || (prev == to && hop.node == from)) {
+                            lspSrlgs[std::make_pair(session.sobj.Tunnel_Id, path.sender.Lsp_Id)].insert(srlgId);
+                            break;
+                        }
+                        prev = hop.node;
+                    }
+                }
+            }
+        }
+    }
+
+    EV_INFO << "Loaded SRLG annotations for " << lspSrlgs.size() << " LSPs" << endl;
+}
+
 void RsvpTeScriptable::buildTunnelPlan()
 {
     tunnelLspOrder.clear();
@@ -175,14 +1083,68 @@ void RsvpTeScriptable::buildTunnelPlan()
         order.clear();
         indexMap.clear();
 
-        for (size_t i = 0; i < session.paths.size(); ++i) {
-            int lspId = session.paths[i].sender.Lsp_Id;
-            order.push_back(lspId);
-            indexMap[lspId] = static_cast<int>(i);
+        for (const auto& path : session.paths)
+            order.push_back(path.sender.Lsp_Id);
+
+        // Keep the primary first and try backups that share the fewest SRLGs with it first
+        if (order.size() > 2) {
+            int primaryLspId = order[0];
+            std::stable_sort(order.begin() + 1, order.end(), [&](int a, int b) {
+                return countSharedSrlgs(tunnelId, primaryLspId, a) < countSharedSrlgs(tunnelId, primaryLspId, b);
+            });
+        }
+
+        for (size_t i = 0; i < order.size(); ++i) {
+            indexMap[order[i]] = static_cast<int>(i);
+            if (i > 0 && countSharedSrlgs(tunnelId, order[0], order[i]) > 0)
+                EV_WARN << "Backup LSP " << order[i] << " of tunnel " << tunnelId
+                        << " shares an SRLG with primary LSP " << order[0] << endl;
         }
     }
 }
 
+int RsvpTeScriptable::countSharedSrlgs(int tunnelId, int lspA, int lspB) const
+{
+    auto a = lspSrlgs.find(std::make_pair(tunnelId, lspA));
+    auto b = lspSrlgs.find(std::make_pair(tunnelId, lspB));
+    if (a == lspSrlgs.end() || b == lspSrlgs.end())
+        return 0;
+
+    int shared = 0;
+    for (int srlg : a->second)
+        shared += b->second.count(srlg);
+    return shared;
+}
+
+bool RsvpTeScriptable::sharesFailedSrlg(int tunnelId, int lspId) const
+{
+    if (failedSrlgs.empty())
+        return false;
+
+    auto it = lspSrlgs.find(std::make_pair(tunnelId, lspId));
+    if (it == lspSrlgs.end())
+        return false;
+
+    for (int srlg : it->second) {
+        if (failedSrlgs.count(srlg))
+            return true;
+    }
+    return false;
+}
+
+void RsvpTeScriptable::setSrlgFailure(int tunnelId, int lspId, bool failed)
+{
+    auto it = lspSrlgs.find(std::make_pair(tunnelId, lspId));
+    if (it == lspSrlgs.end())
+        return;
+
+    for (int srlg : it->second) {
+        if (failed ? failedSrlgs.insert(srlg).second : failedSrlgs.erase(srlg) > 0)
+            EV_INFO << "SRLG " << srlg << (failed ? " failed" : " recovered") << " (tunnel " << tunnelId
+                    << " LSP " << lspId << ")" << endl;
+    }
+}
+
 RsvpTeScriptable::traffic_session_t *RsvpTeScriptable::findSessionByTunnel(int tunnelId)
 {
     for (auto& session : traffic) {
@@ -260,7 +1222,9 @@ void RsvpTeScriptable::switchToIndex(int tunnelId, int targetIndex, const char *
         int existingPending = tunnelPendingIndex.count(tunnelId) ? tunnelPendingIndex[tunnelId] : -1;
         if (existingPending != targetIndex) {
             EV_INFO << "Triggering path setup for tunnel " << tunnelId << " lspId " << lspId << endl;
-            createPath(session->sobj, path->sender);
+            if (!requestPathSetup(tunnelId, lspId, SIGNALLING_RESTORATION))
+                return;
+            recordDecision(tunnelId, lspId, -1, currentIndex, targetIndex, FlightRecorder::EVENT_PENDING_SETUP, reason);
             tunnelPendingIndex[tunnelId] = targetIndex;
         }
         else {
@@ -272,6 +1236,7 @@ void RsvpTeScriptable::switchToIndex(int tunnelId, int targetIndex, const char *
     int inLabel = getInLabel(session->sobj, path->sender);
 
     if (inLabel < 0) {
+        recordDecision(tunnelId, lspId, -1, currentIndex, targetIndex, FlightRecorder::EVENT_PENDING_LABEL, reason);
         tunnelPendingIndex[tunnelId] = targetIndex;
         EV_INFO << "Pending switch of tunnel " << tunnelId << " to LSP " << lspId
                 << " (index " << targetIndex << ") until RESV installs a label" << endl;
@@ -288,7 +1253,10 @@ void RsvpTeScriptable::switchToIndex(int tunnelId, int targetIndex, const char *
     }
 
     if (rebound) {
+        recordDecision(tunnelId, lspId, inLabel, currentIndex, targetIndex, FlightRecorder::EVENT_SWITCH, reason);
         tunnelActiveIndex[tunnelId] = targetIndex;
+        tunnelSwitchTime[tunnelId] = simTime();
+        numSwitches++;
         tunnelPendingIndex.erase(tunnelId);
         EV_WARN << "**SWITCH** Tunnel " << tunnelId << " from index " << currentIndex
                 << " to index " << targetIndex << " (LSP " << lspId << ", label " << inLabel
@@ -301,6 +1269,65 @@ void RsvpTeScriptable::switchToIndex(int tunnelId, int targetIndex, const char *
     }
 }
 
+bool RsvpTeScriptable::requestPathSetup(int tunnelId, int lspId, SignallingClass signallingClass)
+{
+    if (traversesDrainedNode(tunnelId, lspId)) {
+        EV_INFO << "Not signalling tunnel " << tunnelId << " lspId " << lspId << ": its route traverses a drained node" << endl;
+        return false;
+    }
+
+    if (!signallingPacing) {
+        traffic_session_t *session = findSessionByTunnel(tunnelId);
+        traffic_path_t *path = findPathByLsp(session, lspId);
+        if (!path)
+            return false;
+        createPath(session->sobj, path->sender);
+        return true;
+    }
+
+    if (!signallingQueued.insert({tunnelId, lspId}).second) {
+        EV_DEBUG << "Path setup for tunnel " << tunnelId << " lspId " << lspId << " already queued" << endl;
+        return true;
+    }
+
+    signallingQueue[signallingClass].push_back({tunnelId, lspId});
+    dispatchSignalling();
+    return true;
+}
+
+void RsvpTeScriptable::dispatchSignalling()
+{
+    // Refill the token bucket
+    simtime_t now = simTime();
+    signallingTokens = std::min(signallingBurst, signallingTokens + (now - signallingTokenTime).dbl() * signallingRate);
+    signallingTokenTime = now;
+
+    // Release queued setups in priority order while tokens are available
+    for (int cls = 0; cls < NUM_SIGNALLING_CLASSES && signallingTokens >= 1; cls++) {
+        auto& queue = signallingQueue[cls];
+        while (!queue.empty() && signallingTokens >= 1) {
+            auto key = queue.front();
+            queue.pop_front();
+            signallingQueued.erase(key);
+
+            traffic_session_t *session = findSessionByTunnel(key.first);
+            traffic_path_t *path = findPathByLsp(session, key.second);
+            if (!path || findPSB(session->sobj, path->sender))
+                continue;
+
+            EV_DETAIL << "Signalling path setup for tunnel " << key.first << " lspId " << key.second
+                      << " (class " << cls << ")" << endl;
+            createPath(session->sobj, path->sender);
+            signallingTokens -= 1;
+        }
+    }
+
+    emit(signallingQueueDepthSignal, (long)signallingQueued.size());
+
+    if (!signallingQueued.empty() && !signallingTimer->isScheduled())
+        scheduleAt(now + (1 - signallingTokens) / signallingRate, signallingTimer);
+}
+
 void RsvpTeScriptable::requestFailover(int tunnelId, const char *reason, bool)
 {
     auto orderIt = tunnelLspOrder.find(tunnelId);
@@ -312,35 +1339,26 @@ void RsvpTeScriptable::requestFailover(int tunnelId, const char *reason, bool)
     if (pendingIt != tunnelPendingIndex.end())
         currentIndex = pendingIt->second;
 
-    traffic_session_t *session = findSessionByTunnel(tunnelId);
-    if (!session)
+    if (!findSessionByTunnel(tunnelId))
         return;
 
-
     int candidate = -1;
-    for (int idx = currentIndex + 1; idx < (int)orderIt->second.size(); ++idx) {
-        int lspId = orderIt->second[idx];
-        traffic_path_t *path = findPathByLsp(session, lspId);
-        if (!path)
-            continue;
-
-
-        bool hasPsb = findPSB(session->sobj, path->sender);
-        if (hasPsb) {
-            int inLabel = getInLabel(session->sobj, path->sender);
-            if (inLabel >= 0) {
-
-                candidate = idx;
-                EV_INFO << "Found immediately available backup path at index " << idx << " (LSP " << lspId << ")" << endl;
-                break;
-            }
-        }
-
-
-        if (candidate < 0) {
-            candidate = idx;
-            EV_INFO << "Found backup path at index " << idx << " (LSP " << lspId << "), will attempt setup" << endl;
-        }
+    switch (selectionPolicy) {
+        case POLICY_LOWEST_LATENCY:
+            candidate = selectFailoverIndex<LowestLatencyPolicy>(tunnelId, currentIndex);
+            break;
+        case POLICY_MOST_HEADROOM:
+            candidate = selectFailoverIndex<MostHeadroomPolicy>(tunnelId, currentIndex);
+            break;
+        case POLICY_STICKY:
+            candidate = selectFailoverIndex<StickyPolicy>(tunnelId, currentIndex);
+            break;
+        case POLICY_REVERTIVE:
+            candidate = selectFailoverIndex<RevertivePolicy>(tunnelId, currentIndex);
+            break;
+        default:
+            candidate = selectFailoverIndex<OrderedPolicy>(tunnelId, currentIndex);
+            break;
     }
 
     if (candidate >= 0) {
@@ -348,35 +1366,116 @@ void RsvpTeScriptable::requestFailover(int tunnelId, const char *reason, bool)
         return;
     }
 
-    int primaryIndex = getPrimaryIndex(tunnelId);
-    if (currentIndex != primaryIndex && primaryUnavailable.count(tunnelId) == 0) {
-        EV_INFO << "No forward backup available, attempting to restore primary path" << endl;
-        switchToIndex(tunnelId, primaryIndex, reason);
-        return;
-    }
+    numNoAlternate++;
+    recordDecision(tunnelId, -1, -1, currentIndex, -1, FlightRecorder::EVENT_NO_ALTERNATE, reason);
+    EV_WARN << "No alternate path available for tunnel " << tunnelId << " when handling " << reason << endl;
+}
 
-    // 最後の手段：全てのパスをチェック（currentIndexより前も含む）
-    for (int idx = 0; idx < (int)orderIt->second.size(); ++idx) {
-        if (idx == currentIndex)
-            continue;
+void RsvpTeScriptable::collectPathCandidates(int tunnelId, bool latency, bool headroom, std::vector<PathCandidate>& paths)
+{
+    const std::vector<int>& order = tunnelLspOrder[tunnelId];
+    traffic_session_t *session = findSessionByTunnel(tunnelId);
+    int primaryIndex = getPrimaryIndex(tunnelId);
 
-        int lspId = orderIt->second[idx];
+    paths.assign(order.size(), PathCandidate());
+    for (size_t idx = 0; idx < order.size(); ++idx) {
+        int lspId = order[idx];
         traffic_path_t *path = findPathByLsp(session, lspId);
         if (!path)
             continue;
 
-        bool hasPsb = findPSB(session->sobj, path->sender);
-        if (hasPsb) {
-            int inLabel = getInLabel(session->sobj, path->sender);
-            if (inLabel >= 0) {
-                EV_INFO << "Found alternative available path at index " << idx << " (LSP " << lspId << ")" << endl;
-                switchToIndex(tunnelId, idx, reason);
-                return;
-            }
+        PathCandidate& candidate = paths[idx];
+        candidate.defined = true;
+        candidate.srlgRisk = sharesFailedSrlg(tunnelId, lspId);
+        candidate.drained = traversesDrainedNode(tunnelId, lspId);
+        candidate.down = ((int)idx == primaryIndex && primaryUnavailable.count(tunnelId) > 0)
+                         || tedFailedLsps.count({tunnelId, lspId}) > 0;
+        candidate.ready = findPSB(session->sobj, path->sender) && getInLabel(session->sobj, path->sender) >= 0;
+        if (!candidate.ready)
+            continue;
+
+        if (latency) {
+            candidate.latency = lspProbe ? lspProbe->getLspDelay(tunnelId, lspId).dbl() : 0.0;
+            candidate.cost = getRouteCost(tunnelId, lspId);
         }
+        if (headroom)
+            candidate.headroom = getRouteHeadroom(tunnelId, lspId, session->sobj.setupPri);
     }
+}
 
-    EV_WARN << "No alternate path available for tunnel " << tunnelId << " when handling " << reason << endl;
+template <typename Policy>
+int RsvpTeScriptable::selectFailoverIndex(int tunnelId, int currentIndex)
+{
+    std::vector<PathCandidate> paths;
+    collectPathCandidates(tunnelId, Policy::needsLatency, Policy::needsHeadroom, paths);
+    int index = Policy::selectFailover(paths, currentIndex, getPrimaryIndex(tunnelId));
+
+    if (index >= 0)
+        EV_INFO << "Policy " << Policy::getName() << " selected index " << index << " (LSP "
+                << tunnelLspOrder[tunnelId][index] << (paths[index].ready ? ", ready" : ", will attempt setup")
+                << ") for tunnel " << tunnelId << endl;
+    return index;
+}
+
+template <typename Policy>
+double RsvpTeScriptable::getRestoreDelay(int tunnelId, const char *reason)
+{
+    RestoreContext context;
+    context.commanded = FlightRecorder::classifyReason(reason) == FlightRecorder::REASON_SCENARIO;
+    auto switchIt = tunnelSwitchTime.find(tunnelId);
+    context.sinceSwitch = switchIt != tunnelSwitchTime.end() ? (simTime() - switchIt->second).dbl() : SIMTIME_MAX.dbl();
+    context.holdTime = revertHoldTime.dbl();
+    return Policy::restoreDelay(context);
+}
+
+int RsvpTeScriptable::findTedLink(inet::Ipv4Address advrouter, inet::Ipv4Address peer) const
+{
+    for (size_t i = 0; i < tedmod->ted.size(); i++) {
+        const auto& link = tedmod->ted[i];
+        if (link.advrouter == advrouter && link.linkid == peer)
+            return i;
+    }
+    return -1;
+}
+
+double RsvpTeScriptable::getRouteCost(int tunnelId, int lspId)
+{
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto it = lspRoutes.find({tunnelId, lspId});
+    if (it == lspRoutes.end())
+        return 0;
+
+    double cost = 0;
+    const std::vector<inet::Ipv4Address>& route = it->second;
+    for (size_t i = 1; i < route.size(); i++) {
+        int link = findTedLink(route[i - 1], route[i]);
+        cost += link >= 0 ? tedmod->ted[link].metric : 1;
+    }
+    return cost;
+}
+
+double RsvpTeScriptable::getRouteHeadroom(int tunnelId, int lspId, int priority)
+{
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto it = lspRoutes.find({tunnelId, lspId});
+    if (it == lspRoutes.end())
+        return 0;
+
+    double headroom = -1;
+    const std::vector<inet::Ipv4Address>& route = it->second;
+    for (size_t i = 1; i < route.size(); i++) {
+        int link = findTedLink(route[i - 1], route[i]);
+        if (link < 0)
+            continue;   // hop not advertised in the TED
+        double unreserved = tedmod->ted[link].UnResvBandwidth[priority];
+        if (headroom < 0 || unreserved < headroom)
+            headroom = unreserved;
+    }
+    return std::max(headroom, 0.0);
 }
 
 void RsvpTeScriptable::requestRestore(int tunnelId, const char *reason, bool dueToCongestion)
@@ -395,6 +1494,35 @@ void RsvpTeScriptable::requestRestore(int tunnelId, const char *reason, bool due
     if (primaryUnavailable.count(tunnelId))
         return;
 
+    if (traversesDrainedNode(tunnelId, orderIt->second[primaryIndex]))
+        return;
+
+    double delay = 0;
+    switch (selectionPolicy) {
+        case POLICY_STICKY:
+            delay = getRestoreDelay<StickyPolicy>(tunnelId, reason);
+            break;
+        case POLICY_REVERTIVE:
+            delay = getRestoreDelay<RevertivePolicy>(tunnelId, reason);
+            break;
+        default:
+            delay = getRestoreDelay<OrderedPolicy>(tunnelId, reason);
+            break;
+    }
+    if (delay < 0) {
+        EV_DETAIL << "Selection policy keeps tunnel " << tunnelId << " off the primary path" << endl;
+        return;
+    }
+    if (delay > 0) {
+        // Retried through the delayed restoration check
+        simtime_t dueTime = simTime() + delay;
+        pathRestoreDueTime[std::make_pair(tunnelId, orderIt->second[primaryIndex])] = dueTime;
+        if (!restorationCheckTimer->isScheduled() || restorationCheckTimer->getArrivalTime() > dueTime)
+            rescheduleAt(dueTime, restorationCheckTimer);
+        EV_INFO << "Selection policy holds restoration of tunnel " << tunnelId << " for " << delay << "s" << endl;
+        return;
+    }
+
     // Verify primary path is fully operational before restoring
     traffic_session_t *session = findSessionByTunnel(tunnelId);
     if (!session)
@@ -422,12 +1550,23 @@ void RsvpTeScriptable::requestRestore(int tunnelId, const char *reason, bool due
     switchToIndex(tunnelId, primaryIndex, reason);
 }
 
-void RsvpTeScriptable::handlePathFailure(int tunnelId, int lspId, const char *reason)
+void RsvpTeScriptable::handlePathFailure(int tunnelId, int lspId, const char *reason, bool sharedRisk)
 {
     int index = findPathIndex(tunnelId, lspId);
     if (index < 0)
         return;
 
+    routeIndexValid = false;
+
+    if (sharedRisk)
+        setSrlgFailure(tunnelId, lspId, true);
+    recordFlap(tunnelId, lspId);
+    recordDecision(tunnelId, lspId, -1, tunnelActiveIndex.count(tunnelId) ? tunnelActiveIndex[tunnelId] : -1, index,
+            FlightRecorder::EVENT_PATH_FAILURE, reason);
+
+    // A path that fails again while waiting for restoration starts over
+    pathRestoreDueTime.erase(std::make_pair(tunnelId, lspId));
+
     bool wasPending = false;
     auto pendingIt = tunnelPendingIndex.find(tunnelId);
     if (pendingIt != tunnelPendingIndex.end() && pendingIt->second == index) {
@@ -462,7 +1601,10 @@ void RsvpTeScriptable::handlePathFailure(int tunnelId, int lspId, const char *re
     EV_WARN << "Active LSP " << lspId << " (index " << index << ") for tunnel " << tunnelId
             << " has failed (" << reason << "), triggering immediate failover" << endl;
 
+    // Failover stays local for speed; the controller re-optimizes afterwards
     requestFailover(tunnelId, reason, false);
+    if (pce)
+        pce->requestComputation(getFullPath().c_str());
 }
 
 void RsvpTeScriptable::handlePathRestored(int tunnelId, int lspId, const char *reason)
@@ -471,6 +1613,8 @@ void RsvpTeScriptable::handlePathRestored(int tunnelId, int lspId, const char *r
     if (index < 0)
         return;
 
+    routeIndexValid = false;
+
     traffic_session_t *session = findSessionByTunnel(tunnelId);
     if (!session)
         return;
@@ -494,20 +1638,26 @@ void RsvpTeScriptable::handlePathRestored(int tunnelId, int lspId, const char *r
 
     EV_INFO << "LSP " << lspId << " for tunnel " << tunnelId << " has PSB and label " << inLabel << endl;
 
+    markLspUp(tunnelId, lspId);
+    setSrlgFailure(tunnelId, lspId, false);
+    recordDecision(tunnelId, lspId, inLabel, tunnelActiveIndex.count(tunnelId) ? tunnelActiveIndex[tunnelId] : -1, index,
+            FlightRecorder::EVENT_PATH_RESTORED, reason);
+
     // For delayed restoration, schedule timer on first detection
-    if (restorationDelay > 0) {
+    simtime_t holdTime = getRestorationHoldTime(tunnelId, lspId);
+    if (holdTime > 0) {
         auto key = std::make_pair(tunnelId, lspId);
-        auto it = pathRestoredTime.find(key);
+        auto it = pathRestoreDueTime.find(key);
 
-        if (it == pathRestoredTime.end()) {
-            // First time - record time and schedule timer
-            pathRestoredTime[key] = simTime();
+        if (it == pathRestoreDueTime.end()) {
+            // First time - record due time and schedule timer
+            simtime_t dueTime = simTime() + holdTime;
+            pathRestoreDueTime[key] = dueTime;
             EV_INFO << "Path restoration detected, scheduling delayed restoration in "
-                    << restorationDelay << "s" << endl;
+                    << holdTime << "s" << endl;
 
-            if (!restorationCheckTimer->isScheduled()) {
-                scheduleAt(simTime() + restorationDelay, restorationCheckTimer);
-            }
+            if (!restorationCheckTimer->isScheduled() || restorationCheckTimer->getArrivalTime() > dueTime)
+                rescheduleAt(dueTime, restorationCheckTimer);
             return; // Don't restore yet
         }
     }
@@ -525,6 +1675,9 @@ void RsvpTeScriptable::handlePathRestored(int tunnelId, int lspId, const char *r
             EV_INFO << "Primary path (LSP " << lspId << ") ready for restoration" << endl;
             requestRestore(tunnelId, reason, false);
         }
+        // Restoration stays local like failover; the controller re-optimizes afterwards
+        if (pce)
+            pce->requestComputation(getFullPath().c_str());
     }
 }
 
@@ -534,18 +1687,21 @@ void RsvpTeScriptable::checkPendingRestorations()
 
     // Collect paths that are ready for restoration
     std::vector<std::pair<int, int>> readyPaths;
+    simtime_t nextDueTime = SIMTIME_MAX;
 
-    for (auto& entry : pathRestoredTime) {
+    for (auto& entry : pathRestoreDueTime) {
         int tunnelId = entry.first.first;
         int lspId = entry.first.second;
-        simtime_t restoredTime = entry.second;
-        simtime_t elapsed = simTime() - restoredTime;
+        simtime_t dueTime = entry.second;
 
-        if (elapsed >= restorationDelay) {
+        if (dueTime <= simTime()) {
             EV_INFO << "Path tunnel=" << tunnelId << " lsp=" << lspId
-                    << " is ready for restoration (elapsed=" << elapsed << "s)" << endl;
+                    << " is ready for restoration (due at " << dueTime << "s)" << endl;
             readyPaths.push_back(entry.first);
         }
+        else if (dueTime < nextDueTime) {
+            nextDueTime = dueTime;
+        }
     }
 
     // Process ready paths - perform restoration directly
@@ -554,7 +1710,7 @@ void RsvpTeScriptable::checkPendingRestorations()
         int lspId = key.second;
 
         // Remove from tracking
-        pathRestoredTime.erase(key);
+        pathRestoreDueTime.erase(key);
 
         // Perform restoration
         int index = findPathIndex(tunnelId, lspId);
@@ -588,17 +1744,100 @@ void RsvpTeScriptable::checkPendingRestorations()
             if (autoRestorePrimary) {
                 requestRestore(tunnelId, "delayed_restoration", false);
             }
+            if (pce)
+                pce->requestComputation(getFullPath().c_str());
         }
     }
 
     // Reschedule if there are still pending restorations
-    if (!pathRestoredTime.empty()) {
-        scheduleAt(simTime() + restorationDelay, restorationCheckTimer);
+    if (nextDueTime < SIMTIME_MAX) {
+        scheduleAt(nextDueTime, restorationCheckTimer);
+    }
+}
+
+double RsvpTeScriptable::decayFlapPenalty(FlapState& state)
+{
+    simtime_t elapsed = simTime() - state.lastUpdate;
+    if (elapsed > 0 && state.penalty > 0)
+        state.penalty *= std::exp2(-(elapsed / flapHalfLife));
+    state.lastUpdate = simTime();
+
+    if (state.suppressed && state.penalty < flapReuseThreshold)
+        state.suppressed = false;
+    return state.penalty;
+}
+
+void RsvpTeScriptable::recordFlap(int tunnelId, int lspId)
+{
+    if (!flapDamping)
+        return;
+
+    // Only an established LSP going down is a flap, not the repeated
+    // PATH_UNFEASIBLE/PATH_FAILED retries during one outage
+    FlapState& state = lspFlapState[std::make_pair(tunnelId, lspId)];
+    if (!state.up)
+        return;
+    state.up = false;
+
+    decayFlapPenalty(state);
+    state.penalty += flapPenalty;
+
+    if (!state.suppressed && state.penalty >= flapSuppressThreshold) {
+        state.suppressed = true;
+        EV_WARN << "LSP " << lspId << " of tunnel " << tunnelId << " is flapping (penalty "
+                << state.penalty << "), suppressing its restoration" << endl;
     }
 }
 
+void RsvpTeScriptable::markLspUp(int tunnelId, int lspId)
+{
+    if (flapDamping)
+        lspFlapState[std::make_pair(tunnelId, lspId)].up = true;
+}
+
+simtime_t RsvpTeScriptable::getRestorationHoldTime(int tunnelId, int lspId)
+{
+    if (!flapDamping)
+        return restorationDelay;
+
+    auto it = lspFlapState.find(std::make_pair(tunnelId, lspId));
+    if (it == lspFlapState.end())
+        return restorationDelay;
+
+    FlapState& state = it->second;
+    decayFlapPenalty(state);
+    if (!state.suppressed)
+        return restorationDelay;
+
+    // Time until the penalty decays below the reuse threshold
+    simtime_t reuseTime = flapHalfLife * std::log2(state.penalty / flapReuseThreshold);
+    if (reuseTime > flapMaxHoldTime)
+        reuseTime = flapMaxHoldTime;
+    EV_INFO << "LSP " << lspId << " of tunnel " << tunnelId << " is suppressed (penalty "
+            << state.penalty << "), holding restoration for " << reuseTime << "s" << endl;
+    return reuseTime > restorationDelay ? reuseTime : restorationDelay;
+}
+
 void RsvpTeScriptable::handleCongestionNotification(int tunnelId, bool congested, const char *source)
 {
+    Enter_Method("handleCongestionNotification");
+
+    if (pce) {
+        // The controller treats the links of the LSP that was active as saturated
+        if (congested) {
+            congestionForced.insert(tunnelId);
+            congestedLsps[tunnelId] = getActiveLspId(tunnelId);
+        }
+        else {
+            congestionForced.erase(tunnelId);
+            congestedLsps.erase(tunnelId);
+        }
+        EV_INFO << "Congestion " << (congested ? "detected" : "cleared") << " for tunnel " << tunnelId << " by " << source
+                << ", deferring to path computation controller" << endl;
+        pce->requestComputation(source);
+        return;
+    }
+
     if (congested) {
         bool inserted = congestionForced.insert(tunnelId).second;
         if (inserted)
@@ -613,4 +1852,367 @@ void RsvpTeScriptable::handleCongestionNotification(int tunnelId, bool congested
     }
 }
 
+std::vector<int> RsvpTeScriptable::planCongestionRelief(int interfaceId, const std::map<int, double>& tunnelRates, double excessRate)
+{
+    Enter_Method_Silent("planCongestionRelief");
+
+    struct Candidate {
+        int tunnelId;
+        double rate;
+        int holdingPri;     // 0 = most important
+    };
+    std::vector<Candidate> candidates;
+
+    for (const auto& elem : tunnelLspOrder) {
+        if (elem.second.size() < 2)
+            continue;   // no backup to move to
+
+        traffic_session_t *session = findSessionByTunnel(elem.first);
+        traffic_path_t *path = findPathByLsp(session, getActiveLspId(elem.first));
+        inet::PathStateBlock *psb = path ? findPSB(session->sobj, path->sender) : nullptr;
+        if (!psb || psb->OutInterface.isUnspecified())
+            continue;
+        inet::NetworkInterface *outInterface = ift->findInterfaceByAddress(psb->OutInterface);
+        if (!outInterface || outInterface->getInterfaceId() != interfaceId)
+            continue;
+
+        // Moving an idle tunnel relieves nothing
+        auto rateIt = tunnelRates.find(elem.first);
+        if (rateIt == tunnelRates.end() || rateIt->second <= 0)
+            continue;
+        candidates.push_back({ elem.first, rateIt->second, session->sobj.holdingPri });
+    }
+
+    // Fewest tunnels: take the largest rates first
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.rate > b.rate; });
+    size_t count = 0;
+    double moved = 0;
+    while (count < candidates.size() && moved < excessRate)
+        moved += candidates[count++].rate;
+
+    // Among sets of that size prefer less important tunnels: swap a chosen
+    // tunnel for a less important one as long as enough rate still moves
+    if (moved >= excessRate) {
+        bool swapped = true;
+        while (swapped) {
+            swapped = false;
+            for (size_t i = 0; i < count && !swapped; i++) {
+                int best = -1;
+                for (size_t j = count; j < candidates.size(); j++) {
+                    if (candidates[j].holdingPri <= candidates[i].holdingPri || moved - candidates[i].rate + candidates[j].rate < excessRate)
+                        continue;
+                    if (best < 0 || candidates[j].holdingPri > candidates[best].holdingPri
+                        || (candidates[j].holdingPri == candidates[best].holdingPri && candidates[j].rate > candidates[best].rate))
+                        best = j;
+                }
+                if (best >= 0) {
+                    moved += candidates[best].rate - candidates[i].rate;
+                    std::swap(candidates[i], candidates[best]);
+                    swapped = true;
+                }
+            }
+        }
+    }
+
+    std::vector<int> plan;
+    for (size_t i = 0; i < count; i++)
+        plan.push_back(candidates[i].tunnelId);
+
+    EV_INFO << "Congestion relief for interface " << interfaceId << ": moving " << plan.size() << " of "
+            << candidates.size() << " tunnels (" << moved << "bps of " << excessRate << "bps excess)" << endl;
+    return plan;
+}
+
+std::vector<RsvpTeScriptable::LspReport> RsvpTeScriptable::reportTunnelLsps(int tunnelId)
+{
+    std::vector<LspReport> reports;
+    auto orderIt = tunnelLspOrder.find(tunnelId);
+    traffic_session_t *session = findSessionByTunnel(tunnelId);
+    if (orderIt == tunnelLspOrder.end() || !session)
+        return reports;
+
+    if (!routeIndexValid)
+        buildRouteIndex();
+
+    auto congestedIt = congestedLsps.find(tunnelId);
+    for (int lspId : orderIt->second) {
+        LspReport report;
+        report.lspId = lspId;
+        report.congested = congestedIt != congestedLsps.end() && congestedIt->second == lspId;
+        if (traffic_path_t *path = findPathByLsp(session, lspId)) {
+            report.reservedBandwidth = path->tspec.req_bandwidth;
+            if (findPSB(session->sobj, path->sender))
+                report.usable = getInLabel(session->sobj, path->sender) >= 0;
+        }
+        // Full route from the route index (ERO completed from the TED)
+        auto routeIt = lspRoutes.find({tunnelId, lspId});
+        if (routeIt != lspRoutes.end())
+            report.route = routeIt->second;
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+void RsvpTeScriptable::applyPlacement(const std::map<int, int>& tunnelIndices, const char *reason)
+{
+    Enter_Method("applyPlacement");
+
+    for (const auto& elem : tunnelIndices) {
+        auto orderIt = tunnelLspOrder.find(elem.first);
+        if (orderIt == tunnelLspOrder.end() || elem.second < 0 || elem.second >= (int)orderIt->second.size())
+            continue;
+        switchToIndex(elem.first, elem.second, reason);
+    }
+}
+
+void RsvpTeScriptable::sampleTunnelRates()
+{
+    simtime_t now = simTime();
+    double dt = (now - autoBandwidthSampleTime).dbl();
+    autoBandwidthSampleTime = now;
+    if (dt <= 0)
+        return;
+
+    for (const auto& elem : tunnelLspOrder) {
+        uint64_t bytes = getTunnelBytes(elem.first);
+        auto it = autoBandwidthLastBytes.find(elem.first);
+        if (it != autoBandwidthLastBytes.end()) {
+            // Replaced or re-signalled LSPs take their counters with them
+            uint64_t diff = bytes >= it->second ? bytes - it->second : bytes;
+            double& peak = autoBandwidthPeakRate[elem.first];
+            peak = std::max(peak, diff * 8.0 / dt);
+        }
+        autoBandwidthLastBytes[elem.first] = bytes;
+    }
+
+    // Finish replacements whose label arrived after their PATH_CREATED notify
+    std::vector<std::pair<int, int>> pending;
+    for (const auto& elem : pendingResizes)
+        pending.push_back(elem.first);
+    for (const auto& key : pending)
+        completeResize(key.first, key.second);
+}
+
+void RsvpTeScriptable::adjustBandwidth()
+{
+    for (auto& elem : autoBandwidthPeakRate) {
+        int tunnelId = elem.first;
+        double bandwidth = std::max(autoBandwidthMin, elem.second * (1 + autoBandwidthHeadroom));
+        if (autoBandwidthMax > 0)
+            bandwidth = std::min(bandwidth, autoBandwidthMax);
+        elem.second = 0;
+
+        // Every LSP of the tunnel may have to carry the whole demand
+        traffic_session_t *session = findSessionByTunnel(tunnelId);
+        for (int lspId : tunnelLspOrder[tunnelId]) {
+            if (pendingResizes.count({tunnelId, lspId}))
+                continue;
+            traffic_path_t *path = findPathByLsp(session, lspId);
+            if (!path)
+                continue;
+            double reserved = path->tspec.req_bandwidth;
+            if (reserved > 0 && std::fabs(bandwidth - reserved) < autoBandwidthThreshold * reserved)
+                continue;
+
+            if (!findPSB(session->sobj, path->sender)) {
+                // Not signalled: the next setup simply uses the new value
+                EV_DETAIL << "Auto-bandwidth: tunnel " << tunnelId << " LSP " << lspId << " reservation "
+                          << reserved << " -> " << bandwidth << "bps (not signalled)" << endl;
+                path->tspec.req_bandwidth = bandwidth;
+                continue;
+            }
+            resizeLsp(tunnelId, lspId, bandwidth);
+        }
+    }
+}
+
+void RsvpTeScriptable::resizeLsp(int tunnelId, int lspId, double bandwidth)
+{
+    traffic_session_t *session = findSessionByTunnel(tunnelId);
+    traffic_path_t replacement = *findPathByLsp(session, lspId);
+    double reserved = replacement.tspec.req_bandwidth;
+    replacement.sender.Lsp_Id = allocateLspId(session);
+    replacement.tspec.req_bandwidth = bandwidth;
+    session->paths.push_back(replacement);
+
+    LspResize& resize = pendingResizes[{tunnelId, lspId}];
+    resize.newLspId = replacement.sender.Lsp_Id;
+    resize.bandwidth = bandwidth;
+
+    EV_INFO << "Auto-bandwidth: resizing tunnel " << tunnelId << " LSP " << lspId << " from " << reserved
+            << " to " << bandwidth << "bps via replacement LSP " << resize.newLspId << endl;
+    if (!requestPathSetup(tunnelId, resize.newLspId, SIGNALLING_SETUP))
+        abandonResize(tunnelId, lspId);    // e.g. route through a drained node; retried next interval
+}
+
+bool RsvpTeScriptable::handleResizeEvent(int tunnelId, int lspId, bool failed)
+{
+    for (const auto& elem : pendingResizes) {
+        if (elem.first.first != tunnelId || elem.second.newLspId != lspId)
+            continue;
+
+        int oldLspId = elem.first.second;
+        if (failed)
+            abandonResize(tunnelId, oldLspId);
+        else
+            completeResize(tunnelId, oldLspId);
+        return true;
+    }
+    return false;
+}
+
+bool RsvpTeScriptable::completeResize(int tunnelId, int oldLspId)
+{
+    auto resizeIt = pendingResizes.find({tunnelId, oldLspId});
+    traffic_session_t *session = findSessionByTunnel(tunnelId);
+    if (resizeIt == pendingResizes.end() || !session)
+        return false;
+
+    int newLspId = resizeIt->second.newLspId;
+    traffic_path_t *newPath = findPathByLsp(session, newLspId);
+    if (!newPath || !findPSB(session->sobj, newPath->sender))
+        return false;
+    int inLabel = getInLabel(session->sobj, newPath->sender);
+    if (inLabel < 0)
+        return false;
+
+    int index = findPathIndex(tunnelId, oldLspId);
+    bool oldUsable = getLspInLabel(tunnelId, oldLspId) >= 0;
+
+    // Make: move the tunnel's FECs onto the new LSP while the old one still forwards
+    if (getActiveLspId(tunnelId) == oldLspId) {
+        for (const auto& fec : classifierExt->getFecEntries()) {
+            if (fec.session.Tunnel_Id == tunnelId)
+                classifierExt->rebindFec(fec.id, session->sobj, newPath->sender, inLabel);
+        }
+    }
+
+    // Break: the new LSP takes the old one's place in the tunnel plan
+    tearDownLsp(session, oldLspId);
+    tunnelLspOrder[tunnelId][index] = newLspId;
+    tunnelLspIndex[tunnelId].erase(oldLspId);
+    tunnelLspIndex[tunnelId][newLspId] = index;
+
+    auto srlgIt = lspSrlgs.find({tunnelId, oldLspId});
+    if (srlgIt != lspSrlgs.end()) {
+        lspSrlgs[{tunnelId, newLspId}] = srlgIt->second;
+        lspSrlgs.erase(srlgIt);
+    }
+    lspFlapState.erase({tunnelId, oldLspId});
+    tedFailedLsps.erase({tunnelId, oldLspId});
+    pathRestoreDueTime.erase({tunnelId, oldLspId});
+    routeIndexValid = false;
+    pendingResizes.erase(resizeIt);
+    numResizes++;
+
+    recordDecision(tunnelId, newLspId, inLabel, index, index, FlightRecorder::EVENT_RESIZE, "auto-bandwidth");
+    EV_INFO << "Auto-bandwidth: tunnel " << tunnelId << " LSP " << oldLspId << " replaced by LSP " << newLspId
+            << " (index " << index << ", label " << inLabel << ")" << endl;
+
+    // A replacement for a failed LSP is a restoration of that index
+    if (!oldUsable)
+        handlePathRestored(tunnelId, newLspId, "auto-bandwidth");
+    return true;
+}
+
+void RsvpTeScriptable::abandonResize(int tunnelId, int oldLspId)
+{
+    auto resizeIt = pendingResizes.find({tunnelId, oldLspId});
+    if (resizeIt == pendingResizes.end())
+        return;
+
+    // The old LSP and its reservation stay in place; retried next interval
+    EV_WARN << "Auto-bandwidth: replacement LSP " << resizeIt->second.newLspId << " for tunnel " << tunnelId
+            << " LSP " << oldLspId << " (" << resizeIt->second.bandwidth << "bps) could not be established" << endl;
+    tearDownLsp(findSessionByTunnel(tunnelId), resizeIt->second.newLspId);
+    pendingResizes.erase(resizeIt);
+    numResizeFailures++;
+}
+
+void RsvpTeScriptable::tearDownLsp(traffic_session_t *session, int lspId)
+{
+    auto pathIt = std::find_if(session->paths.begin(), session->paths.end(), [&](const traffic_path_t& path) {
+        return path.sender.Lsp_Id == lspId;
+    });
+    if (pathIt == session->paths.end())
+        return;
+
+    if (inet::PathStateBlock *psb = findPSB(session->sobj, pathIt->sender)) {
+        if (!psb->OutInterface.isUnspecified())
+            sendPathTearMessage(tedmod->getPeerByLocalAddress(psb->OutInterface), psb->Session_Object,
+                    psb->Sender_Template_Object, psb->OutInterface, routerId, true);
+        removePSB(psb);
+    }
+    session->paths.erase(pathIt);
+}
+
+int RsvpTeScriptable::allocateLspId(const traffic_session_t *session) const
+{
+    int lspId = 0;
+    for (const auto& path : session->paths)
+        lspId = std::max(lspId, path.sender.Lsp_Id);
+    return lspId + 1;
+}
+
+int RsvpTeScriptable::getActiveLspId(int tunnelId) const
+{
+    auto orderIt = tunnelLspOrder.find(tunnelId);
+    auto activeIt = tunnelActiveIndex.find(tunnelId);
+    if (orderIt == tunnelLspOrder.end() || activeIt == tunnelActiveIndex.end())
+        return -1;
+    if (activeIt->second < 0 || activeIt->second >= (int)orderIt->second.size())
+        return -1;
+    return orderIt->second[activeIt->second];
+}
+
+int RsvpTeScriptable::getLspInLabel(int tunnelId, int lspId)
+{
+    traffic_session_t *session = findSessionByTunnel(tunnelId);
+    traffic_path_t *path = findPathByLsp(session, lspId);
+    if (!path || !findPSB(session->sobj, path->sender))
+        return -1;
+    return getInLabel(session->sobj, path->sender);
+}
+
+bool RsvpTeScriptable::getLspTraffic(int tunnelId, int lspId, uint64_t& packets, uint64_t& bytes)
+{
+    const LabelCounters *counters = classifierExt ? classifierExt->getLabelCounters() : nullptr;
+    int inLabel = counters ? getLspInLabel(tunnelId, lspId) : -1;
+    if (inLabel < 0)
+        return false;
+
+    const auto& counter = counters->get(inLabel);
+    packets = counter.packets;
+    bytes = counter.bytes;
+    return true;
+}
+
+uint64_t RsvpTeScriptable::getTunnelBytes(int tunnelId, int interfaceId)
+{
+    auto it = tunnelLspOrder.find(tunnelId);
+    if (it == tunnelLspOrder.end())
+        return 0;
+
+    traffic_session_t *session = interfaceId >= 0 ? findSessionByTunnel(tunnelId) : nullptr;
+    if (interfaceId >= 0 && !session)
+        return 0;
+
+    uint64_t total = 0;
+    for (int lspId : it->second) {
+        if (interfaceId >= 0) {
+            traffic_path_t *path = findPathByLsp(session, lspId);
+            inet::PathStateBlock *psb = path ? findPSB(session->sobj, path->sender) : nullptr;
+            if (!psb || psb->OutInterface.isUnspecified())
+                continue;
+            inet::NetworkInterface *outInterface = ift->findInterfaceByAddress(psb->OutInterface);
+            if (!outInterface || outInterface->getInterfaceId() != interfaceId)
+                continue;
+        }
+        uint64_t packets = 0, bytes = 0;
+        if (getLspTraffic(tunnelId, lspId, packets, bytes))
+            total += bytes;
+    }
+    return total;
+}
+
 } // namespace insotu
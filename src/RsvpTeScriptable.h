@@ -1,11 +1,17 @@
 #ifndef __INET_RSVPTESCRIPTABLE_H
 #define __INET_RSVPTESCRIPTABLE_H
 
+#include <deque>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 #include <omnetpp.h>
 
+#include "FlightRecorder.h"
+#include "PathSelectionPolicy.h"
+#include "TopologyImage.h"
+
 #include "inet/common/scenario/IScriptable.h"
 #include "inet/networklayer/rsvpte/RsvpTe.h"
 #include "inet/networklayer/rsvpte/SignallingMsg_m.h"
@@ -13,9 +19,12 @@
 using namespace omnetpp;
 
 namespace insotu {
+class LspProbeGenerator;
+class PathComputationController;
 class RsvpClassifierScriptable;
+class TopologyImageLoader;
 
-class RsvpTeScriptable : public inet::RsvpTe
+class RsvpTeScriptable : public inet::RsvpTe, public cListener
 {
   protected:
     using traffic_session_t = inet::RsvpTe::traffic_session_t;
@@ -31,18 +40,139 @@ class RsvpTeScriptable : public inet::RsvpTe
     std::set<int> primaryUnavailable;
     bool autoRestorePrimary = true;
 
-    // Delayed restoration: track when paths were restored
-    std::map<std::pair<int, int>, simtime_t> pathRestoredTime;
+    // Failover/restore policy, fixed at initialization (see PathSelectionPolicy.h)
+    enum SelectionPolicy { POLICY_ORDERED, POLICY_LOWEST_LATENCY, POLICY_MOST_HEADROOM, POLICY_STICKY, POLICY_REVERTIVE };
+    SelectionPolicy selectionPolicy = POLICY_ORDERED;
+    simtime_t revertHoldTime;
+    std::map<int, simtime_t> tunnelSwitchTime;
+    LspProbeGenerator *lspProbe = nullptr;
+    long numSwitches = 0;
+    long numNoAlternate = 0;
+
+    // Delayed restoration: track when restored paths may be used again
+    std::map<std::pair<int, int>, simtime_t> pathRestoreDueTime;
     simtime_t restorationDelay = 0;
     cMessage *restorationCheckTimer = nullptr;
 
+    // Flap damping: per-LSP penalty that grows on every up -> down transition
+    // and decays exponentially; suppressed LSPs are not restored until it
+    // falls below reuse
+    struct FlapState {
+        double penalty = 0;
+        simtime_t lastUpdate;
+        bool suppressed = false;
+        bool up = false;                // established (label installed) since the last failure
+    };
+    std::map<std::pair<int, int>, FlapState> lspFlapState;
+    bool flapDamping = false;
+    double flapPenalty = 0;
+    double flapSuppressThreshold = 0;
+    double flapReuseThreshold = 0;
+    simtime_t flapHalfLife = 0;
+    simtime_t flapMaxHoldTime = 0;
+
+    // Shared risk link groups: SRLG ids per (tunnelId, lspId), and the SRLGs
+    // in which an LSP has failed and none has been re-established since
+    std::map<std::pair<int, int>, std::set<int>> lspSrlgs;
+    std::set<int> failedSrlgs;
+
+    // Signalling pacing: createPath() requests are queued per priority class
+    // and released by a token bucket to avoid PATH bursts
+    enum SignallingClass { SIGNALLING_RESTORATION = 0, SIGNALLING_SETUP, NUM_SIGNALLING_CLASSES };
+    std::deque<std::pair<int, int>> signallingQueue[NUM_SIGNALLING_CLASSES];
+    std::set<std::pair<int, int>> signallingQueued;
+    bool signallingPacing = false;
+    double signallingRate = 0;          // PATH setups per second
+    double signallingBurst = 0;
+    double signallingTokens = 0;
+    simtime_t signallingTokenTime;
+    cMessage *signallingTimer = nullptr;
+    simsignal_t signallingQueueDepthSignal;
+
+    // Refresh reduction (RFC 2961): after the initial PATH/RESV, states are
+    // refreshed by one Summary Refresh per neighbour and refresh interval
+    // instead of per-PSB/RSB timers and full messages
+    struct NeighbourRefresh {
+        std::set<int> psbIds;
+        std::set<int> rsbIds;
+        cMessage *timer = nullptr;
+    };
+    std::map<inet::Ipv4Address, NeighbourRefresh> neighbourRefresh;
+    bool refreshReduction = false;
+    simtime_t summaryRefreshInterval;
+    long numSummaryRefreshesSent = 0;
+    long numSummaryEntriesSent = 0;
+    long numRefreshNacksSent = 0;
+
+    // Central path computation: when attached, congestion decisions are
+    // delegated to the controller; failures and primary restoration stay
+    // local and are followed by a recomputation
+    PathComputationController *pce = nullptr;
+    std::map<int, int> congestedLsps;   // tunnel -> LSP active when congestion was reported
+
+    // Bulk scenario commands: routers (by router ID) on the current route of
+    // every signalled LSP and the reverse index, rebuilt lazily after path events.
+    // Hops the ERO leaves open (loose hops, no ERO) are taken from the TED
+    std::map<std::pair<int, int>, std::vector<inet::Ipv4Address>> lspRoutes;
+    std::map<inet::Ipv4Address, std::set<std::pair<int, int>>> nodeLspIndex;
+    bool routeIndexValid = false;
+    std::set<inet::Ipv4Address> drainedNodes;
+
+    // Proactive invalidation: LSPs per TE link (router pair, either direction)
+    // from the same route index; LSPs on links the local TED reports down are
+    // failed over at once and ignore the PATH_NOTIFY that confirms it later
+    std::map<std::pair<inet::Ipv4Address, inet::Ipv4Address>, std::set<std::pair<int, int>>> linkLspIndex;
+    std::set<std::pair<int, int>> tedFailedLsps;
+    std::vector<bool> tedLinkState;     // last seen state per TED entry
+    bool tedInvalidation = false;
+    long numTedInvalidations = 0;
+
+    // Auto-bandwidth: the peak tunnel rate over each adjustment interval plus
+    // headroom becomes the new reservation; signalled LSPs are resized
+    // make-before-break by a replacement LSP under a new LSP ID
+    struct LspResize {
+        int newLspId = -1;
+        double bandwidth = 0;
+    };
+    std::map<std::pair<int, int>, LspResize> pendingResizes;   // by (tunnelId, old lspId)
+    std::map<int, uint64_t> autoBandwidthLastBytes;
+    std::map<int, double> autoBandwidthPeakRate;
+    bool autoBandwidth = false;
+    simtime_t autoBandwidthSampleInterval;
+    simtime_t autoBandwidthInterval;
+    double autoBandwidthHeadroom = 0;
+    double autoBandwidthThreshold = 0;
+    double autoBandwidthMin = 0;
+    double autoBandwidthMax = 0;
+    simtime_t autoBandwidthSampleTime;
+    simtime_t autoBandwidthAdjustTime;
+    cMessage *autoBandwidthTimer = nullptr;
+    long numResizes = 0;
+    long numResizeFailures = 0;
+
+    // Compact binary audit trail of switching decisions
+    FlightRecorder flightRecorder;
+    std::string flightRecorderFile;
+
+    // Precompiled traffic sessions, used instead of the traffic parameter
+    TopologyImageLoader *topologyImage = nullptr;
+
   protected:
     virtual void initialize(int stage) override;
     virtual void handleMessageWhenUp(cMessage *msg) override;
     virtual void processCommand(const cXMLElement& node) override;
     virtual void processPATH_NOTIFY(inet::PathNotifyMsg *msg) override;
+    virtual void processPSB_TIMER(inet::PsbTimerMsg *msg) override;
+    virtual void processRSB_REFRESH_TIMER(inet::RsbRefreshTimerMsg *msg) override;
+    virtual void finish() override;
+    virtual void receiveSignal(cComponent *source, simsignal_t signalID, cObject *obj, cObject *details) override;
 
+    virtual void readTrafficFromXML(const cXMLElement *sessions) override;
+    void readSrlgConfig(const cXMLElement *config);
     void buildTunnelPlan();
+    int countSharedSrlgs(int tunnelId, int lspA, int lspB) const;
+    bool sharesFailedSrlg(int tunnelId, int lspId) const;
+    void setSrlgFailure(int tunnelId, int lspId, bool failed);
     traffic_session_t *findSessionByTunnel(int tunnelId);
     traffic_path_t *findPathByLsp(traffic_session_t *session, int lspId);
     int getPrimaryIndex(int tunnelId) const { return 0; }
@@ -51,12 +181,92 @@ class RsvpTeScriptable : public inet::RsvpTe
     void switchToIndex(int tunnelId, int targetIndex, const char *reason);
     void requestFailover(int tunnelId, const char *reason, bool dueToCongestion);
     void requestRestore(int tunnelId, const char *reason, bool dueToCongestion);
-    void handlePathFailure(int tunnelId, int lspId, const char *reason);
+    void collectPathCandidates(int tunnelId, bool latency, bool headroom, std::vector<PathCandidate>& paths);
+    template <typename Policy> int selectFailoverIndex(int tunnelId, int currentIndex);
+    template <typename Policy> double getRestoreDelay(int tunnelId, const char *reason);
+    int findTedLink(inet::Ipv4Address advrouter, inet::Ipv4Address peer) const;
+    double getRouteCost(int tunnelId, int lspId);
+    double getRouteHeadroom(int tunnelId, int lspId, int priority);
+    // sharedRisk: a link/node failure, which also marks the LSP's SRLGs failed
+    // (not for preemption or an unfeasible route)
+    void handlePathFailure(int tunnelId, int lspId, const char *reason, bool sharedRisk);
     void handlePathRestored(int tunnelId, int lspId, const char *reason);
     void checkPendingRestorations();
+    double decayFlapPenalty(FlapState& state);
+    void recordFlap(int tunnelId, int lspId);
+    void markLspUp(int tunnelId, int lspId);
+    simtime_t getRestorationHoldTime(int tunnelId, int lspId);
+    bool requestPathSetup(int tunnelId, int lspId, SignallingClass signallingClass);
+    void dispatchSignalling();
+    size_t getSignallingQueueDepth() const { return signallingQueued.size(); }
+    NeighbourRefresh& getNeighbourRefresh(inet::Ipv4Address neighbour);
+    bool handleNeighbourRefreshTimer(cMessage *msg);
+    void sendSummaryRefresh(inet::Ipv4Address neighbour, NeighbourRefresh& state);
+    void processSummaryRefresh(inet::Packet *packet);
+    void processSlaNotify(inet::Packet *packet);
+    inet::Ipv4Address resolveRouter(const char *address) const;
+    inet::Ipv4Address toRouterId(inet::Ipv4Address address) const;
+    void buildRouteIndex();
+    bool completeRoute(std::vector<inet::Ipv4Address>& route, inet::Ipv4Address target) const;
+    bool traversesDrainedNode(int tunnelId, int lspId);
+    static std::pair<inet::Ipv4Address, inet::Ipv4Address> linkKey(inet::Ipv4Address a, inet::Ipv4Address b);
+    void collectLspsOnLink(inet::Ipv4Address a, inet::Ipv4Address b, std::set<std::pair<int, int>>& lsps);
+    bool crossesDownLink(int tunnelId, int lspId);
+    void invalidateLsps(const std::set<std::pair<int, int>>& lsps);
+    void revalidateLsps(const std::set<std::pair<int, int>>& lsps);
+    void parseTunnelList(const char *list, std::set<int>& tunnels) const;
+    void collectTunnelsVia(inet::Ipv4Address node, inet::Ipv4Address peer, bool primaryLsp, std::set<int>& tunnels);
+    void applyBulkReroute(const std::set<int>& tunnels, bool restore, const char *reason);
+    void sampleTunnelRates();
+    void adjustBandwidth();
+    void resizeLsp(int tunnelId, int lspId, double bandwidth);
+    bool handleResizeEvent(int tunnelId, int lspId, bool failed);
+    bool completeResize(int tunnelId, int oldLspId);
+    void abandonResize(int tunnelId, int oldLspId);
+    void tearDownLsp(traffic_session_t *session, int lspId);
+    int allocateLspId(const traffic_session_t *session) const;
+    void recordDecision(int tunnelId, int lspId, int label, int fromIndex, int toIndex, FlightRecorder::Event event, const char *reason);
+    void dumpFlightRecorder(const char *filename);
 
   public:
     void handleCongestionNotification(int tunnelId, bool congested, const char *source);
+
+    // Congestion relief: the fewest tunnels (by measured rate, then least
+    // important by holding priority) whose active LSP leaves through the
+    // interface and whose failover moves at least excessRate bps away
+    std::vector<int> planCongestionRelief(int interfaceId, const std::map<int, double>& tunnelRates, double excessRate);
+
+    // LSP state for OAM and monitoring modules
+    const std::map<int, std::vector<int>>& getTunnelLspOrder() const { return tunnelLspOrder; }
+    int getActiveLspId(int tunnelId) const;
+    int getLspInLabel(int tunnelId, int lspId);
+
+    // Traffic actually forwarded on an LSP / all LSPs of a tunnel (ingress label counters);
+    // with interfaceId >= 0 only LSPs whose PSB leaves through that interface are counted
+    bool getLspTraffic(int tunnelId, int lspId, uint64_t& packets, uint64_t& bytes);
+    uint64_t getTunnelBytes(int tunnelId, int interfaceId = -1);
+
+    // LSP state reported to a PathComputationController
+    struct LspReport {
+        int lspId = -1;
+        bool usable = false;                // PSB and label installed
+        double reservedBandwidth = 0;       // bps
+        bool congested = false;             // was active when the tunnel reported congestion
+        std::vector<inet::Ipv4Address> route;   // router IDs from this router (empty if no PSB)
+    };
+    std::vector<LspReport> reportTunnelLsps(int tunnelId);
+    inet::Ipv4Address getRouterId() const { return routerId; }
+    void setPathComputationController(PathComputationController *controller) { pce = controller; }
+    void setLspProbe(LspProbeGenerator *probe) { lspProbe = probe; }
+    void applyPlacement(const std::map<int, int>& tunnelIndices, const char *reason);
+
+    // Egress side: in-label -> (tunnelId, lspId) of the LSPs ending at this
+    // router, and SLA feedback to the headends of a tunnel
+    void collectEgressLabels(std::map<int, std::pair<int, int>>& labelLsps);
+    void sendSlaNotify(int tunnelId, bool violated, const char *source);
+
+    // Adds the configured traffic sessions to a topology image being compiled
+    void storeTraffic(TopologyImage::Builder& builder) const;
 };
 
 } // namespace insotu
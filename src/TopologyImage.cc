@@ -0,0 +1,351 @@
+#include "TopologyImage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace insotu {
+
+TopologyImage::Builder::Builder(const char *network, int scaleExp) :
+    scaleExp(scaleExp)
+{
+    this->network = addString(network);
+}
+
+uint32_t TopologyImage::Builder::addString(const std::string& s)
+{
+    if (s.empty())
+        return 0;
+    uint32_t offset = strings.size();
+    strings.append(s.c_str(), s.size() + 1);
+    return offset;
+}
+
+void TopologyImage::Builder::beginRouter(const char *name)
+{
+    Router r;
+    r.name = addString(name);
+    r.firstInterface = interfaces.size();
+    r.numInterfaces = 0;
+    r.firstRoute = routes.size();
+    r.numRoutes = 0;
+    r.firstSession = sessions.size();
+    r.numSessions = 0;
+    r.firstFec = fecs.size();
+    r.numFecs = 0;
+    routers.push_back(r);
+}
+
+void TopologyImage::Builder::addInterface(const char *name, uint32_t address, uint32_t netmask, int mtu, int metric, const std::vector<uint32_t>& joinedGroups)
+{
+    Interface i;
+    i.name = addString(name);
+    i.address = address;
+    i.netmask = netmask;
+    i.mtu = mtu;
+    i.metric = metric;
+    i.firstGroup = groups.size();
+    i.numGroups = joinedGroups.size();
+    groups.insert(groups.end(), joinedGroups.begin(), joinedGroups.end());
+    interfaces.push_back(i);
+    routers.back().numInterfaces++;
+}
+
+void TopologyImage::Builder::addRoute(uint32_t destination, uint32_t netmask, uint32_t gateway, const char *interfaceName, int metric, unsigned int adminDist)
+{
+    Route r;
+    r.destination = destination;
+    r.netmask = netmask;
+    r.gateway = gateway;
+    r.interfaceName = addString(interfaceName);
+    r.metric = metric;
+    r.adminDist = adminDist;
+    routes.push_back(r);
+    routers.back().numRoutes++;
+}
+
+void TopologyImage::Builder::addSession(uint32_t destAddress, int tunnelId, int extendedTunnelId, int setupPri, int holdingPri)
+{
+    Session s;
+    s.destAddress = destAddress;
+    s.tunnelId = tunnelId;
+    s.extendedTunnelId = extendedTunnelId;
+    s.setupPri = setupPri;
+    s.holdingPri = holdingPri;
+    s.firstPath = paths.size();
+    s.numPaths = 0;
+    sessions.push_back(s);
+    routers.back().numSessions++;
+}
+
+void TopologyImage::Builder::addPath(uint32_t srcAddress, int lspId, double bandwidth, int64_t maxDelay, int owner, int color, bool permanent,
+                                     const std::vector<Hop>& route)
+{
+    Path p;
+    memset(&p, 0, sizeof(p));
+    p.srcAddress = srcAddress;
+    p.lspId = lspId;
+    p.bandwidth = bandwidth;
+    p.maxDelay = maxDelay;
+    p.owner = owner;
+    p.color = color;
+    p.firstHop = hops.size();
+    p.numHops = route.size();
+    p.permanent = permanent ? 1 : 0;
+    hops.insert(hops.end(), route.begin(), route.end());
+    paths.push_back(p);
+    sessions.back().numPaths++;
+}
+
+void TopologyImage::Builder::addFec(const Fec& fec)
+{
+    fecs.push_back(fec);
+    routers.back().numFecs++;
+}
+
+bool TopologyImage::Builder::addSource(const char *path)
+{
+    for (const auto& source : sources) {
+        if (!strcmp(strings.c_str() + source.path, path))
+            return true;
+    }
+    Source s;
+    if (!statFile(path, s.size, s.mtime))
+        return false;
+    s.path = addString(path);
+    s.reserved = 0;
+    sources.push_back(s);
+    return true;
+}
+
+bool TopologyImage::Builder::write(const char *filename, std::string& error)
+{
+    // Sorted by name for binary search; the ranges move with the records
+    std::sort(routers.begin(), routers.end(), [this](const Router& a, const Router& b) {
+        return strcmp(strings.c_str() + a.name, strings.c_str() + b.name) < 0;
+    });
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "TOPI", 4);
+    header.version = VERSION;
+    header.numSections = NUM_SECTIONS;
+    header.scaleExp = scaleExp;
+    header.network = network;
+
+    struct Chunk { const void *data; size_t count; size_t recordSize; };
+    Chunk chunks[NUM_SECTIONS] = {
+        { routers.data(), routers.size(), sizeof(Router) },
+        { interfaces.data(), interfaces.size(), sizeof(Interface) },
+        { groups.data(), groups.size(), sizeof(uint32_t) },
+        { routes.data(), routes.size(), sizeof(Route) },
+        { sessions.data(), sessions.size(), sizeof(Session) },
+        { paths.data(), paths.size(), sizeof(Path) },
+        { hops.data(), hops.size(), sizeof(Hop) },
+        { fecs.data(), fecs.size(), sizeof(Fec) },
+        { sources.data(), sources.size(), sizeof(Source) },
+        { strings.data(), strings.size(), 1 },
+    };
+
+    // Sections start 8-byte aligned so records can be used in place
+    uint64_t offset = sizeof(Header);
+    for (int i = 0; i < NUM_SECTIONS; i++) {
+        offset = (offset + 7) & ~(uint64_t)7;
+        header.sections[i].offset = offset;
+        header.sections[i].count = chunks[i].count;
+        header.sections[i].recordSize = chunks[i].recordSize;
+        offset += chunks[i].count * chunks[i].recordSize;
+    }
+
+    FILE *f = fopen(filename, "wb");
+    if (!f) {
+        error = std::string("cannot create ") + filename;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t position = sizeof(Header);
+    static const char padding[8] = {};
+    for (int i = 0; ok && i < NUM_SECTIONS; i++) {
+        size_t gap = header.sections[i].offset - position;
+        if (gap > 0)
+            ok = fwrite(padding, 1, gap, f) == gap;
+        size_t bytes = chunks[i].count * chunks[i].recordSize;
+        if (ok && bytes > 0)
+            ok = fwrite(chunks[i].data, 1, bytes, f) == bytes;
+        position = header.sections[i].offset + bytes;
+    }
+    if (fclose(f) != 0 || !ok) {
+        error = std::string("cannot write ") + filename;
+        return false;
+    }
+    return true;
+}
+
+bool TopologyImage::open(const char *filename, std::string& error)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE view = fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!view) {
+        error = std::string("cannot map ") + filename;
+        return false;
+    }
+    data = static_cast<const uint8_t *>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        CloseHandle(view);
+        error = std::string("cannot map ") + filename;
+        return false;
+    }
+    mapping = view;
+    size = fileSize.QuadPart;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    struct stat st;
+    void *addr = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        error = std::string("cannot map ") + filename;
+        return false;
+    }
+    data = static_cast<const uint8_t *>(addr);
+    size = st.st_size;
+#endif
+
+    if (!validate(error)) {
+        error = std::string(filename) + ": " + error;
+        close();
+        return false;
+    }
+    header = reinterpret_cast<const Header *>(data);
+    return true;
+}
+
+void TopologyImage::close()
+{
+    if (data) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+#else
+        munmap(const_cast<uint8_t *>(data), size);
+#endif
+    }
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+    header = nullptr;
+}
+
+bool TopologyImage::validate(std::string& error) const
+{
+    if (size < sizeof(Header)) {
+        error = "not a topology image";
+        return false;
+    }
+    const Header *h = reinterpret_cast<const Header *>(data);
+    if (memcmp(h->magic, "TOPI", 4) != 0) {
+        error = "not a topology image";
+        return false;
+    }
+    if (h->version != VERSION || h->numSections != NUM_SECTIONS) {
+        error = "image version " + std::to_string(h->version) + ", expected " + std::to_string(VERSION) + "; recompile it";
+        return false;
+    }
+
+    static const size_t recordSizes[NUM_SECTIONS] = {
+        sizeof(Router), sizeof(Interface), sizeof(uint32_t), sizeof(Route), sizeof(Session),
+        sizeof(Path), sizeof(Hop), sizeof(Fec), sizeof(Source), 1
+    };
+    for (int i = 0; i < NUM_SECTIONS; i++) {
+        const SectionEntry& s = h->sections[i];
+        if (s.recordSize != recordSizes[i] || s.offset % 8 != 0 || s.offset > size
+            || (uint64_t)s.count * s.recordSize > size - s.offset)
+        {
+            error = "corrupt section table";
+            return false;
+        }
+    }
+    const SectionEntry& strings = h->sections[SECTION_STRINGS];
+    if (strings.count == 0 || data[strings.offset + strings.count - 1] != 0) {
+        error = "corrupt string table";
+        return false;
+    }
+
+    // Ranges are checked once here, so accessors need no bounds checks
+    auto fits = [h](Section section, uint32_t first, uint32_t count) {
+        return (uint64_t)first + count <= h->sections[section].count;
+    };
+    auto records = [this, h](Section section) {
+        return data + h->sections[section].offset;
+    };
+    bool ok = true;
+    const Router *routers = reinterpret_cast<const Router *>(records(SECTION_ROUTERS));
+    for (uint32_t i = 0; ok && i < h->sections[SECTION_ROUTERS].count; i++) {
+        const Router& r = routers[i];
+        ok = fits(SECTION_INTERFACES, r.firstInterface, r.numInterfaces) && fits(SECTION_ROUTES, r.firstRoute, r.numRoutes)
+             && fits(SECTION_SESSIONS, r.firstSession, r.numSessions) && fits(SECTION_FECS, r.firstFec, r.numFecs);
+    }
+    const Interface *interfaces = reinterpret_cast<const Interface *>(records(SECTION_INTERFACES));
+    for (uint32_t i = 0; ok && i < h->sections[SECTION_INTERFACES].count; i++)
+        ok = fits(SECTION_GROUPS, interfaces[i].firstGroup, interfaces[i].numGroups);
+    const Session *sessions = reinterpret_cast<const Session *>(records(SECTION_SESSIONS));
+    for (uint32_t i = 0; ok && i < h->sections[SECTION_SESSIONS].count; i++)
+        ok = fits(SECTION_PATHS, sessions[i].firstPath, sessions[i].numPaths);
+    const Path *paths = reinterpret_cast<const Path *>(records(SECTION_PATHS));
+    for (uint32_t i = 0; ok && i < h->sections[SECTION_PATHS].count; i++)
+        ok = fits(SECTION_HOPS, paths[i].firstHop, paths[i].numHops);
+    if (!ok)
+        error = "corrupt record ranges";
+    return ok;
+}
+
+const char *TopologyImage::getString(uint32_t offset) const
+{
+    const SectionEntry& strings = header->sections[SECTION_STRINGS];
+    if (offset >= strings.count)
+        return "";
+    return reinterpret_cast<const char *>(data + strings.offset + offset);
+}
+
+const TopologyImage::Router *TopologyImage::findRouter(const char *name) const
+{
+    Range<Router> routers = getRouters();
+    const Router *it = std::lower_bound(routers.begin(), routers.end(), name, [this](const Router& r, const char *key) {
+        return strcmp(getString(r.name), key) < 0;
+    });
+    return it != routers.end() && !strcmp(getString(it->name), name) ? it : nullptr;
+}
+
+bool TopologyImage::statFile(const char *path, int64_t& size, int64_t& mtime)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+} // namespace insotu
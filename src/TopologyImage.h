@@ -0,0 +1,248 @@
+#ifndef __INSOTU_TOPOLOGYIMAGE_H
+#define __INSOTU_TOPOLOGYIMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace insotu {
+
+/**
+ * Precompiled binary image of the static network configuration
+ *
+ * Holds per router what is otherwise parsed from text on every run: the
+ * interface configuration and static routes of the .rt routing files, the
+ * RSVP-TE traffic sessions and the FEC table. The image is compiled from
+ * the state a normal run has built (see TopologyImageLoader), so addresses
+ * and endpoints are stored resolved, and is memory-mapped on load; records
+ * are used in place without parsing.
+ *
+ * File layout (host byte order): Header with one SectionEntry per Section,
+ * then the sections. Each section is an array of fixed-size records; all
+ * strings are offsets into the STRINGS section (NUL-terminated, offset 0 is
+ * the empty string). Per-router data is referenced by first/count ranges
+ * into the other sections, and ROUTERS is sorted by name. Addresses are
+ * IPv4 addresses as 32-bit integers, times raw simtime values at the
+ * simtime scale exponent of the header.
+ *
+ * Independent of OMNeT++ and INET, like FlightRecorder.
+ */
+class TopologyImage
+{
+  public:
+    enum Section {
+        SECTION_ROUTERS = 0,
+        SECTION_INTERFACES,
+        SECTION_GROUPS,             // multicast groups joined by interfaces
+        SECTION_ROUTES,
+        SECTION_SESSIONS,
+        SECTION_PATHS,
+        SECTION_HOPS,               // explicit route objects of paths
+        SECTION_FECS,
+        SECTION_SOURCES,            // input files the image was compiled from
+        SECTION_STRINGS,
+        NUM_SECTIONS
+    };
+
+    struct SectionEntry {
+        uint64_t offset;
+        uint32_t count;
+        uint32_t recordSize;        // 1 for STRINGS
+    };
+
+    struct Header {
+        char magic[4];              // "TOPI"
+        uint16_t version;
+        uint16_t numSections;
+        int32_t scaleExp;           // simtime scale exponent
+        uint32_t network;           // string: NED type of the network
+        SectionEntry sections[NUM_SECTIONS];
+    };
+
+    struct Router {
+        uint32_t name;              // string: full path of the node module
+        uint32_t firstInterface, numInterfaces;
+        uint32_t firstRoute, numRoutes;
+        uint32_t firstSession, numSessions;
+        uint32_t firstFec, numFecs;
+    };
+
+    struct Interface {
+        uint32_t name;              // string: interface name (e.g. "ppp0")
+        uint32_t address;
+        uint32_t netmask;
+        int32_t mtu;
+        int32_t metric;
+        uint32_t firstGroup, numGroups;
+    };
+
+    struct Route {
+        uint32_t destination;
+        uint32_t netmask;
+        uint32_t gateway;
+        uint32_t interfaceName;     // string
+        int32_t metric;
+        uint32_t adminDist;
+    };
+
+    struct Session {
+        uint32_t destAddress;
+        int32_t tunnelId;
+        int32_t extendedTunnelId;
+        int32_t setupPri;
+        int32_t holdingPri;
+        uint32_t firstPath, numPaths;
+    };
+
+    struct Path {
+        uint32_t srcAddress;
+        int32_t lspId;
+        double bandwidth;           // bps
+        int64_t maxDelay;           // raw simtime
+        int32_t owner;
+        int32_t color;
+        uint32_t firstHop, numHops;
+        uint8_t permanent;
+        uint8_t reserved[7];
+    };
+
+    struct Hop {
+        uint32_t node;
+        uint32_t loose;
+    };
+
+    struct Fec {
+        int32_t id;
+        uint32_t src;
+        uint32_t dest;
+        uint32_t sessionDest;
+        int32_t tunnelId;
+        int32_t extendedTunnelId;
+        int32_t setupPri;
+        int32_t holdingPri;
+        uint32_t senderAddress;
+        int32_t lspId;
+        int32_t inLabel;
+    };
+
+    struct Source {
+        uint32_t path;              // string, as given in the configuration
+        uint32_t reserved;
+        int64_t size;
+        int64_t mtime;
+    };
+
+    static_assert(sizeof(Router) == 36 && sizeof(Interface) == 28 && sizeof(Route) == 24 && sizeof(Session) == 28
+                  && sizeof(Path) == 48 && sizeof(Hop) == 8 && sizeof(Fec) == 44 && sizeof(Source) == 24,
+                  "TopologyImage records must keep their size");
+
+    static const uint16_t VERSION = 1;
+
+    // Array view into a mapped section
+    template <typename T>
+    struct Range {
+        const T *first = nullptr;
+        uint32_t count = 0;
+
+        const T *begin() const { return first; }
+        const T *end() const { return first + count; }
+        uint32_t size() const { return count; }
+        const T& operator[](uint32_t i) const { return first[i]; }
+    };
+
+    /**
+     * Collects the records of an image and writes it. Routers are added one
+     * at a time: beginRouter() and then its interfaces, routes, sessions
+     * (each followed by its paths) and FEC entries.
+     */
+    class Builder
+    {
+      protected:
+        std::vector<Router> routers;
+        std::vector<Interface> interfaces;
+        std::vector<uint32_t> groups;
+        std::vector<Route> routes;
+        std::vector<Session> sessions;
+        std::vector<Path> paths;
+        std::vector<Hop> hops;
+        std::vector<Fec> fecs;
+        std::vector<Source> sources;
+        std::string strings = std::string(1, '\0');
+        uint32_t network = 0;
+        int32_t scaleExp = 0;
+
+      public:
+        Builder(const char *network, int scaleExp);
+
+        uint32_t addString(const std::string& s);
+
+        void beginRouter(const char *name);
+        void addInterface(const char *name, uint32_t address, uint32_t netmask, int mtu, int metric, const std::vector<uint32_t>& groups);
+        void addRoute(uint32_t destination, uint32_t netmask, uint32_t gateway, const char *interfaceName, int metric, unsigned int adminDist);
+        void addSession(uint32_t destAddress, int tunnelId, int extendedTunnelId, int setupPri, int holdingPri);
+        // Adds a path with its explicit route (node, loose) to the last session
+        void addPath(uint32_t srcAddress, int lspId, double bandwidth, int64_t maxDelay, int owner, int color, bool permanent,
+                     const std::vector<Hop>& route);
+        void addFec(const Fec& fec);
+        // Records an input file; its size and modification time are taken now. False if it cannot be read
+        bool addSource(const char *path);
+
+        size_t getNumRouters() const { return routers.size(); }
+
+        // Returns false with a message in error on I/O error
+        bool write(const char *filename, std::string& error);
+    };
+
+  protected:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    void *mapping = nullptr;            // platform mapping handle
+    const Header *header = nullptr;
+
+  public:
+    TopologyImage() = default;
+    TopologyImage(const TopologyImage&) = delete;
+    TopologyImage& operator=(const TopologyImage&) = delete;
+    ~TopologyImage() { close(); }
+
+    // Maps the file and validates its structure; returns false with a message in error
+    bool open(const char *filename, std::string& error);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    const char *getNetwork() const { return getString(header->network); }
+    int getScaleExp() const { return header->scaleExp; }
+    const char *getString(uint32_t offset) const;
+
+    Range<Router> getRouters() const { return getSection<Router>(SECTION_ROUTERS, 0, header->sections[SECTION_ROUTERS].count); }
+    const Router *findRouter(const char *name) const;
+
+    Range<Interface> getInterfaces(const Router& r) const { return getSection<Interface>(SECTION_INTERFACES, r.firstInterface, r.numInterfaces); }
+    Range<uint32_t> getGroups(const Interface& i) const { return getSection<uint32_t>(SECTION_GROUPS, i.firstGroup, i.numGroups); }
+    Range<Route> getRoutes(const Router& r) const { return getSection<Route>(SECTION_ROUTES, r.firstRoute, r.numRoutes); }
+    Range<Session> getSessions(const Router& r) const { return getSection<Session>(SECTION_SESSIONS, r.firstSession, r.numSessions); }
+    Range<Path> getPaths(const Session& s) const { return getSection<Path>(SECTION_PATHS, s.firstPath, s.numPaths); }
+    Range<Hop> getHops(const Path& p) const { return getSection<Hop>(SECTION_HOPS, p.firstHop, p.numHops); }
+    Range<Fec> getFecs(const Router& r) const { return getSection<Fec>(SECTION_FECS, r.firstFec, r.numFecs); }
+    Range<Source> getSources() const { return getSection<Source>(SECTION_SOURCES, 0, header->sections[SECTION_SOURCES].count); }
+
+    // Size and modification time of a file, as stored in Source; false if it cannot be read
+    static bool statFile(const char *path, int64_t& size, int64_t& mtime);
+
+  protected:
+    template <typename T>
+    Range<T> getSection(Section section, uint32_t first, uint32_t count) const
+    {
+        Range<T> range;
+        range.first = reinterpret_cast<const T *>(data + header->sections[section].offset) + first;
+        range.count = count;
+        return range;
+    }
+
+    bool validate(std::string& error) const;
+};
+
+} // namespace insotu
+
+#endif
@@ -0,0 +1,232 @@
+#include "TopologyImageLoader.h"
+
+#include "RsvpClassifierScriptable.h"
+#include "RsvpTeScriptable.h"
+#include "inet/common/ModuleAccess.h"
+#include "inet/networklayer/common/L3AddressResolver.h"
+#include "inet/networklayer/ipv4/IIpv4RoutingTable.h"
+#include "inet/networklayer/ipv4/Ipv4InterfaceData.h"
+#include "inet/networklayer/ipv4/Ipv4Route.h"
+
+namespace insotu {
+
+Define_Module(TopologyImageLoader);
+
+void TopologyImageLoader::initialize(int stage)
+{
+    cSimpleModule::initialize(stage);
+
+    if (stage == inet::INITSTAGE_LOCAL) {
+        enabled = par("enabled").boolValue();
+        if (!enabled)
+            return;
+
+        filename = par("file").stdstringValue();
+        compile = !strcmp(par("mode").stringValue(), "compile");
+        if (filename.empty())
+            throw cRuntimeError("No topology image file configured");
+
+        if (!compile) {
+            openImage();
+            if (par("checkSources").boolValue())
+                checkSources();
+        }
+    }
+    else if (stage == inet::INITSTAGE_NETWORK_ADDRESS_ASSIGNMENT) {
+        if (enabled && !compile)
+            configureInterfaces();
+    }
+    else if (stage == inet::INITSTAGE_STATIC_ROUTING) {
+        if (enabled && !compile)
+            addRoutes();
+    }
+    else if (stage == inet::INITSTAGE_LAST) {
+        if (enabled && compile) {
+            compileImage();
+            if (par("endAfterCompile").boolValue()) {
+                endTimer = new cMessage("topologyImageCompiled");
+                scheduleAt(simTime(), endTimer);
+            }
+        }
+    }
+}
+
+void TopologyImageLoader::handleMessage(cMessage *msg)
+{
+    if (msg == endTimer) {
+        EV_INFO << "Topology image compiled, ending the run" << endl;
+        endSimulation();
+    }
+    else
+        delete msg;
+}
+
+void TopologyImageLoader::openImage()
+{
+    std::string error;
+    if (!image.open(filename.c_str(), error))
+        throw cRuntimeError("Cannot load topology image '%s': %s", filename.c_str(), error.c_str());
+
+    const char *network = getSimulation()->getSystemModule()->getNedTypeName();
+    if (strcmp(image.getNetwork(), network))
+        throw cRuntimeError("Topology image '%s' was compiled for network %s, not %s",
+                filename.c_str(), image.getNetwork(), network);
+    if (image.getScaleExp() != SimTime::getScaleExp())
+        throw cRuntimeError("Topology image '%s' was compiled with simtime-resolution 10^%d s, this run uses 10^%d s",
+                filename.c_str(), image.getScaleExp(), SimTime::getScaleExp());
+
+    EV_INFO << "Mapped topology image " << filename << " with " << image.getRouters().size() << " router(s)" << endl;
+}
+
+void TopologyImageLoader::checkSources()
+{
+    for (const auto& source : image.getSources()) {
+        const char *path = image.getString(source.path);
+        int64_t size, mtime;
+        if (!TopologyImage::statFile(path, size, mtime))
+            throw cRuntimeError("Topology image '%s' is out of date: input file '%s' cannot be read", filename.c_str(), path);
+        if (size != source.size || mtime != source.mtime)
+            throw cRuntimeError("Topology image '%s' is out of date: '%s' changed since it was compiled; recompile it with mode=\"compile\"",
+                    filename.c_str(), path);
+    }
+}
+
+void TopologyImageLoader::configureInterfaces()
+{
+    for (const auto& router : image.getRouters()) {
+        const char *name = image.getString(router.name);
+        cModule *node = getSimulation()->findModuleByPath(name);
+        if (!node)
+            throw cRuntimeError("Topology image '%s' configures unknown node '%s'", filename.c_str(), name);
+        inet::IInterfaceTable *ift = inet::L3AddressResolver().findInterfaceTableOf(node);
+        if (!ift)
+            throw cRuntimeError("Topology image '%s': node '%s' has no interface table", filename.c_str(), name);
+
+        for (const auto& entry : image.getInterfaces(router)) {
+            const char *interfaceName = image.getString(entry.name);
+            inet::NetworkInterface *ie = ift->findInterfaceByName(interfaceName);
+            if (!ie)
+                throw cRuntimeError("Topology image '%s': %s has no interface '%s'", filename.c_str(), name, interfaceName);
+
+            auto ipv4Data = ie->getProtocolDataForUpdate<inet::Ipv4InterfaceData>();
+            ipv4Data->setIPAddress(inet::Ipv4Address(entry.address));
+            ipv4Data->setNetmask(inet::Ipv4Address(entry.netmask));
+            ipv4Data->setMetric(entry.metric);
+            if (entry.mtu > 0)
+                ie->setMtu(entry.mtu);
+            for (uint32_t group : image.getGroups(entry)) {
+                inet::Ipv4Address address(group);
+                if (!ipv4Data->isMemberOfMulticastGroup(address))
+                    ipv4Data->joinMulticastGroup(address);
+            }
+        }
+    }
+}
+
+void TopologyImageLoader::addRoutes()
+{
+    int numRoutes = 0;
+    for (const auto& router : image.getRouters()) {
+        cModule *node = getSimulation()->getModuleByPath(image.getString(router.name));
+        inet::IInterfaceTable *ift = inet::L3AddressResolver().findInterfaceTableOf(node);
+        inet::IIpv4RoutingTable *rt = inet::L3AddressResolver().findIpv4RoutingTableOf(node);
+        if (!rt)
+            throw cRuntimeError("Topology image '%s': node '%s' has no IPv4 routing table", filename.c_str(), node->getFullPath().c_str());
+
+        for (const auto& entry : image.getRoutes(router)) {
+            const char *interfaceName = image.getString(entry.interfaceName);
+            inet::NetworkInterface *ie = *interfaceName ? ift->findInterfaceByName(interfaceName) : nullptr;
+            if (*interfaceName && !ie)
+                throw cRuntimeError("Topology image '%s': %s has no interface '%s'", filename.c_str(), node->getFullPath().c_str(), interfaceName);
+
+            auto route = new inet::Ipv4Route();
+            route->setSourceType(inet::IRoute::MANUAL);
+            route->setDestination(inet::Ipv4Address(entry.destination));
+            route->setNetmask(inet::Ipv4Address(entry.netmask));
+            route->setGateway(inet::Ipv4Address(entry.gateway));
+            route->setInterface(ie);
+            route->setMetric(entry.metric);
+            route->setAdminDist(entry.adminDist);
+            rt->addRoute(route);
+            numRoutes++;
+        }
+    }
+    EV_INFO << "Added " << numRoutes << " static route(s) from topology image" << endl;
+}
+
+void TopologyImageLoader::compileImage()
+{
+    cModule *network = getSimulation()->getSystemModule();
+    TopologyImage::Builder builder(network->getNedTypeName(), SimTime::getScaleExp());
+
+    // Input files whose changes invalidate the image
+    auto addSource = [&](cModule *module, const char *parName, bool isXml) {
+        if (!module || !module->hasPar(parName))
+            return;
+        const char *path = isXml ? module->par(parName).xmlValue()->getSourceFileName() : module->par(parName).stringValue();
+        if (path && *path && !builder.addSource(path))
+            EV_WARN << "Input file '" << path << "' of " << module->getFullPath()
+                    << " cannot be read, changes to it will not be detected" << endl;
+    };
+
+    for (cModule::SubmoduleIterator it(network); !it.end(); ++it) {
+        cModule *node = *it;
+        inet::IInterfaceTable *ift = inet::L3AddressResolver().findInterfaceTableOf(node);
+        inet::IIpv4RoutingTable *rt = inet::L3AddressResolver().findIpv4RoutingTableOf(node);
+        if (!ift || !rt)
+            continue;
+
+        builder.beginRouter(node->getFullPath().c_str());
+
+        for (int i = 0; i < ift->getNumInterfaces(); i++) {
+            inet::NetworkInterface *ie = ift->getInterface(i);
+            auto ipv4Data = ie->findProtocolData<inet::Ipv4InterfaceData>();
+            if (ie->isLoopback() || !ipv4Data)
+                continue;
+            std::vector<uint32_t> groups;
+            for (int j = 0; j < ipv4Data->getNumOfJoinedMulticastGroups(); j++)
+                groups.push_back(ipv4Data->getJoinedMulticastGroup(j).getInt());
+            builder.addInterface(ie->getInterfaceName(), ipv4Data->getIPAddress().getInt(), ipv4Data->getNetmask().getInt(),
+                    ie->getMtu(), ipv4Data->getMetric(), groups);
+        }
+
+        // Only the static routes; interface routes follow from the interface configuration
+        for (int i = 0; i < rt->getNumRoutes(); i++) {
+            inet::Ipv4Route *route = rt->getRoute(i);
+            if (route->getSourceType() != inet::IRoute::MANUAL)
+                continue;
+            builder.addRoute(route->getDestination().getInt(), route->getNetmask().getInt(), route->getGateway().getInt(),
+                    route->getInterface() ? route->getInterface()->getInterfaceName() : "", route->getMetric(), route->getAdminDist());
+        }
+        addSource(dynamic_cast<cModule *>(rt), "routingFile", false);
+
+        if (auto rsvp = dynamic_cast<RsvpTeScriptable *>(node->getSubmodule("rsvp"))) {
+            rsvp->storeTraffic(builder);
+            addSource(rsvp, "traffic", true);
+        }
+        if (auto classifier = dynamic_cast<RsvpClassifierScriptable *>(node->getSubmodule("classifier"))) {
+            classifier->storeFecEntries(builder);
+            addSource(classifier, "config", true);
+        }
+    }
+
+    std::string error;
+    if (!builder.write(filename.c_str(), error))
+        throw cRuntimeError("Cannot write topology image '%s': %s", filename.c_str(), error.c_str());
+    EV_INFO << "Compiled topology image " << filename << " with " << builder.getNumRouters() << " router(s)" << endl;
+}
+
+const TopologyImage::Router *TopologyImageLoader::findRouter(const cModule *module) const
+{
+    if (!image.isOpen())
+        return nullptr;
+    return image.findRouter(inet::getContainingNode(module)->getFullPath().c_str());
+}
+
+void TopologyImageLoader::finish()
+{
+    cancelAndDelete(endTimer);
+    endTimer = nullptr;
+}
+
+} // namespace insotu
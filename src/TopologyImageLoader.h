@@ -0,0 +1,61 @@
+#ifndef __INSOTU_TOPOLOGYIMAGELOADER_H
+#define __INSOTU_TOPOLOGYIMAGELOADER_H
+
+#include <omnetpp.h>
+#include "inet/common/InitStages.h"
+#include "TopologyImage.h"
+
+using namespace omnetpp;
+
+namespace insotu {
+
+/**
+ * Loads the static configuration of all routers from a precompiled
+ * TopologyImage instead of parsing .rt routing files and RSVP traffic/FEC
+ * XML on every run, or compiles such an image.
+ *
+ * mode "compile": the run is set up from the text configuration as usual;
+ * at INITSTAGE_LAST the resulting interface configuration, static routes,
+ * RSVP-TE traffic and FEC tables are written to file, together with size
+ * and modification time of every input file, and the run ends.
+ *
+ * mode "load": the image is mapped at INITSTAGE_LOCAL and rejected if it was
+ * compiled for another network or simtime scale, or (checkSources) if one
+ * of its input files changed since. Interfaces are configured at
+ * INITSTAGE_NETWORK_ADDRESS_ASSIGNMENT and static routes added at
+ * INITSTAGE_STATIC_ROUTING, where INET reads the routing files; the RSVP
+ * and classifier modules pick up their records through getImage() when
+ * they read their (then empty) XML configuration.
+ */
+class TopologyImageLoader : public cSimpleModule
+{
+  protected:
+    bool enabled = false;
+    bool compile = false;
+    std::string filename;
+    TopologyImage image;
+    cMessage *endTimer = nullptr;
+
+  protected:
+    virtual int numInitStages() const override { return inet::NUM_INIT_STAGES; }
+    virtual void initialize(int stage) override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    void openImage();
+    void checkSources();
+    void configureInterfaces();
+    void addRoutes();
+    void compileImage();
+
+  public:
+    // The mapped image in load mode, nullptr otherwise
+    const TopologyImage *getImage() const { return enabled && !compile ? &image : nullptr; }
+
+    // Records of the node containing module, nullptr if the image has none
+    const TopologyImage::Router *findRouter(const cModule *module) const;
+};
+
+} // namespace insotu
+
+#endif
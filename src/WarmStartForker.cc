@@ -0,0 +1,183 @@
+#include "WarmStartForker.h"
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace insotu {
+
+Define_Module(WarmStartForker);
+
+void WarmStartForker::initialize()
+{
+    enabled = par("enabled").boolValue();
+    if (!enabled)
+        return;
+
+    forkTime = par("forkTime");
+    maxParallelForks = par("maxParallelForks").intValue();
+    if (forkTime <= simTime())
+        throw cRuntimeError("forkTime must be positive");
+    if (maxParallelForks < 0)
+        throw cRuntimeError("maxParallelForks must not be negative");
+
+    forkTimer = new cMessage("warmStartFork");
+    scheduleAt(forkTime, forkTimer);
+
+    WATCH(forkIndex);
+}
+
+void WarmStartForker::handleMessage(cMessage *msg)
+{
+    if (msg == forkTimer)
+        forkScenarios();
+    else
+        delete msg;
+}
+
+void WarmStartForker::forkScenarios()
+{
+    cXMLElementList scenarios = par("scenarios").xmlValue()->getChildrenByTagName("fork");
+    if (scenarios.empty()) {
+        EV_WARN << "No <fork> scenarios configured, continuing without fan-out" << endl;
+        return;
+    }
+
+    EV_INFO << "Warm-up converged at " << simTime() << ", forking " << scenarios.size() << " scenario(s)" << endl;
+
+    int nextIndex = 0;
+    int failures = 0;
+    for (cXMLElement *scenario : scenarios) {
+        const char *repeatAttr = scenario->getAttribute("repeat");
+        int repeat = repeatAttr ? atoi(repeatAttr) : 1;
+        if (repeat < 1)
+            throw cRuntimeError("Invalid repeat count '%s' at %s", repeatAttr, scenario->getSourceLocation());
+
+        for (int repetition = 0; repetition < repeat; repetition++, nextIndex++) {
+            if (maxParallelForks > 0 && (int)children.size() >= maxParallelForks)
+                if (!waitForChild())
+                    failures++;
+
+            // Buffered output would otherwise be written once per process
+            std::cout.flush();
+            fflush(stdout);
+            fflush(stderr);
+
+            pid_t pid = fork();
+            if (pid < 0)
+                throw cRuntimeError("fork() failed: %s", strerror(errno));
+
+            if (pid == 0) {
+                children.clear();
+                forkIndex = nextIndex;
+                redirectResults();
+                startScenario(scenario, repetition);
+                return;
+            }
+
+            EV_INFO << "Forked scenario '" << scenario->getAttribute("name") << "' repetition " << repetition
+                    << " as pid " << pid << endl;
+            children.push_back(pid);
+        }
+    }
+
+    while (!children.empty())
+        if (!waitForChild())
+            failures++;
+
+    EV_INFO << "All forked scenarios finished, " << failures << " failed" << endl;
+    if (failures > 0)
+        throw cRuntimeError("%d forked scenario(s) failed", failures);
+
+    // The results are the children's; ending the run normally would call finish()
+    // everywhere and record the parent's state at the fork point as well
+    std::cout.flush();
+    exit(0);
+}
+
+void WarmStartForker::redirectResults()
+{
+    cConfiguration *cfg = getEnvir()->getConfig();
+    for (const char *option : { "output-scalar-file", "output-vector-file" }) {
+        std::string file = cfg->getAsFilename(cConfigOption::get(option));
+        if (!file.empty() && file[0] == '/')
+            throw cRuntimeError("Forked scenarios need a relative %s, not '%s'", option, file.c_str());
+    }
+
+    std::string dir = "fork" + std::to_string(forkIndex);
+    if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+        throw cRuntimeError("Cannot create directory '%s': %s", dir.c_str(), strerror(errno));
+    if (chdir(dir.c_str()) != 0)
+        throw cRuntimeError("Cannot change to directory '%s': %s", dir.c_str(), strerror(errno));
+}
+
+bool WarmStartForker::waitForChild()
+{
+    int status = 0;
+    pid_t pid;
+    do {
+        pid = waitpid(-1, &status, 0);
+    } while (pid < 0 && errno == EINTR);
+    if (pid < 0)
+        throw cRuntimeError("waitpid() failed: %s", strerror(errno));
+
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        if (*it == pid) {
+            children.erase(it);
+            break;
+        }
+    }
+
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!ok)
+        EV_WARN << "Forked scenario pid " << pid << " exited abnormally (status " << status << ")" << endl;
+    return ok;
+}
+
+void WarmStartForker::startScenario(cXMLElement *scenario, int repetition)
+{
+    const char *name = scenario->getAttribute("name");
+    const char *seedAttr = scenario->getAttribute("seedSet");
+    int seedSet = (seedAttr ? atoi(seedAttr) : getEnvir()->getConfigEx()->getActiveRunNumber()) + repetition;
+
+    EV_INFO << "Child " << getpid() << " running scenario '" << (name ? name : "") << "' repetition "
+            << repetition << " (seed set " << seedSet << ")" << endl;
+
+    if (repetition > 0 || seedAttr)
+        reseedRngs(seedSet);
+
+    // The scenario element itself serves as the <scenario> root of the script
+    std::string managerName = std::string("forkScenario") + (name ? std::string("_") + name : "");
+    cModuleType *type = cModuleType::get(par("scenarioManagerType"));
+    cModule *manager = type->create(managerName.c_str(), getSimulation()->getSystemModule());
+    manager->par("script").setXMLValue(scenario);
+    manager->finalizeParameters();
+    manager->buildInside();
+    manager->scheduleStart(simTime());
+    manager->callInitialize();
+}
+
+void WarmStartForker::reseedRngs(int seedSet)
+{
+    cConfiguration *cfg = getEnvir()->getConfig();
+    int numRngs = getEnvir()->getNumRNGs();
+    for (int i = 0; i < numRngs; i++)
+        getEnvir()->getRNG(i)->initialize(seedSet, i, numRngs, 0, 1, cfg);
+}
+
+void WarmStartForker::finish()
+{
+    if (isForkedChild())
+        recordScalar("forkIndex", forkIndex);
+
+    cancelAndDelete(forkTimer);
+    forkTimer = nullptr;
+}
+
+} // namespace insotu
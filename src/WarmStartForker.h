@@ -0,0 +1,70 @@
+#ifndef __INSOTU_WARMSTARTFORKER_H
+#define __INSOTU_WARMSTARTFORKER_H
+
+#include <sys/types.h>
+
+#include <vector>
+#include <omnetpp.h>
+
+using namespace omnetpp;
+
+namespace insotu {
+
+/**
+ * Warm-start scenario fan-out
+ *
+ * Runs the start-up (LSP establishment, RESV exchange, application start)
+ * once, then at forkTime forks one child process per <fork> element of the
+ * scenarios parameter. Every child continues from the identical converged
+ * state, sharing the parent's memory copy-on-write, and executes its own
+ * scenario script through a ScenarioManager created in the child. The
+ * parent waits for all children and exits without recording results.
+ *
+ * Each child changes its working directory to fork<N> (N = fork index)
+ * before anything is recorded, so the result files and flight recorder
+ * dumps, which the default ${resultdir} places relative to the working
+ * directory, are separate per child. Absolute result file names are
+ * rejected, and input files must be loaded before the fork.
+ *
+ * Scenario format (times are absolute and must lie after forkTime):
+ *   <forks>
+ *     <fork name="linkDown" repeat="3">
+ *       <at t="10"> ... ScenarioManager commands ... </at>
+ *     </fork>
+ *   </forks>
+ *
+ * Each repetition of a fork reseeds the RNGs with a distinct seed set so
+ * repetitions diverge after the fork point.
+ */
+class WarmStartForker : public cSimpleModule
+{
+  protected:
+    bool enabled = false;
+    simtime_t forkTime;
+    int maxParallelForks = 0;
+    cMessage *forkTimer = nullptr;
+
+    // Valid in a child process only
+    int forkIndex = -1;
+
+    std::vector<pid_t> children;
+
+  protected:
+    virtual void initialize() override;
+    virtual void handleMessage(cMessage *msg) override;
+    virtual void finish() override;
+
+    void forkScenarios();
+    void startScenario(cXMLElement *scenario, int repetition);
+    void reseedRngs(int seedSet);
+    void redirectResults();
+    bool waitForChild();
+
+  public:
+    bool isForkedChild() const { return forkIndex >= 0; }
+    int getForkIndex() const { return forkIndex; }
+};
+
+} // namespace insotu
+
+#endif
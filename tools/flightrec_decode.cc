@@ -0,0 +1,28 @@
+//
+// Decoder for RsvpTeScriptable flight recorder dumps
+//
+// Build: g++ -O2 -o flightrec_decode tools/flightrec_decode.cc src/FlightRecorder.cc
+// Usage: flightrec_decode <file.flrc>...
+//
+#include <iostream>
+
+#include "../src/FlightRecorder.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.flrc>..." << std::endl;
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argc > 2)
+            std::cout << "== " << argv[i] << std::endl;
+        if (!insotu::FlightRecorder::decode(argv[i], std::cout)) {
+            std::cerr << argv[i] << ": cannot read flight recorder dump" << std::endl;
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+#
+# Simulation performance regression check
+#
+# Runs the canonical configurations headless in Cmdenv (express mode, logging
+# off, results as configured into out/perf-results), measures wall time,
+# event count, events per second, simulated seconds per wall second and peak
+# RSS of each run, writes them as JSON and compares them against
+# tools/perf_baseline.json.
+#
+# Usage (normally through "make perf" / "make perf-baseline" in src/):
+#   perf_regression.py --sim src/Insotu --inet ../inet4.5 [--output results.json]
+#                      [--baseline tools/perf_baseline.json] [--tolerance 0.15]
+#                      [--repeat 3] [--update-baseline] [--only CONFIG]...
+#
+# A configuration without a baseline entry is only measured and reported
+# ("record only"); record baselines with --update-baseline ("make
+# perf-baseline") on the reference machine first.
+#
+# Exit status: 0 within tolerance or no baseline, 1 regression, 2 run failure
+# or bad usage.
+#
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(TOOLS_DIR)
+SIM_DIR = os.path.join(PROJECT_DIR, "simulations")
+DEFAULT_BASELINE = os.path.join(TOOLS_DIR, "perf_baseline.json")
+
+# name -> (ini file, config); names are the keys of the baseline
+CANONICAL_RUNS = {
+    "MPLSDynamic_Test1": ("MPLSDynamic.ini", "MPLSDynamic_Test1"),
+    "MPLSDynamic_Congestion": ("MPLSDynamic.ini", "MPLSDynamic_Congestion"),
+    "MPLSTE": ("MPLSTE.ini", "MPLSTE_otamshi"),
+}
+
+# metric -> +1 if higher is better, -1 if lower is better
+COMPARED_METRICS = {
+    "wallTime": -1,
+    "eventsPerSecond": +1,
+    "simSecondsPerSecond": +1,
+    "peakRssKiB": -1,
+}
+
+# Cmdenv express mode end of run line, e.g.
+# "<!> Simulation time limit reached -- at t=60s, event #1234567"
+END_RE = re.compile(r"at t=([0-9.eE+-]+)s, event #(\d+)")
+
+
+def run_once(sim, inet, ini, config):
+    nedpath = os.pathsep.join([os.path.join(PROJECT_DIR, "src"), SIM_DIR, os.path.join(inet, "src")])
+    resultdir = os.path.join(PROJECT_DIR, "out", "perf-results")
+    cmd = [sim, "-u", "Cmdenv", "-f", ini, "-c", config, "-r", "0", "-n", nedpath,
+           "--cmdenv-express-mode=true", "--**.cmdenv-log-level=off",
+           "--cmdenv-status-frequency=1000s", "--cmdenv-performance-display=false",
+           "--record-eventlog=false", "--result-dir=" + resultdir]
+
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, cwd=SIM_DIR, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    output = proc.stdout.read()
+    usage = None
+    if hasattr(os, "wait4"):
+        # wait4 gives the resource usage of this child alone
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status)
+    else:
+        proc.wait()
+    wall = time.monotonic() - start
+
+    matches = END_RE.findall(output)
+    if proc.returncode != 0 or not matches:
+        sys.stderr.write(output[-2000:])
+        raise RuntimeError("%s -c %s failed (exit code %d)" % (ini, config, proc.returncode))
+
+    simtime, events = float(matches[-1][0]), int(matches[-1][1])
+    # ru_maxrss is in KiB on Linux and in bytes on macOS; not available on Windows
+    rss = None
+    if usage:
+        rss = usage.ru_maxrss // 1024 if platform.system() == "Darwin" else usage.ru_maxrss
+    return {
+        "wallTime": round(wall, 3),
+        "events": events,
+        "simTime": simtime,
+        "eventsPerSecond": round(events / wall, 1) if wall > 0 else 0,
+        "simSecondsPerSecond": round(simtime / wall, 3) if wall > 0 else 0,
+        "peakRssKiB": rss,
+    }
+
+
+def measure(sim, inet, name, repeat):
+    ini, config = CANONICAL_RUNS[name]
+    runs = [run_once(sim, inet, ini, config) for _ in range(repeat)]
+    # Fastest run for the timings (least disturbed), largest footprint for memory
+    best = min(runs, key=lambda r: r["wallTime"])
+    result = dict(best)
+    if best["peakRssKiB"] is not None:
+        result["peakRssKiB"] = max(r["peakRssKiB"] for r in runs)
+    result["repeat"] = repeat
+    return result
+
+
+def compare(results, baseline, tolerance):
+    """Returns the number of regressions, printing one line per metric"""
+    regressions = 0
+    for name, result in results.items():
+        base = baseline.get("runs", {}).get(name)
+        if not base:
+            print("%-24s no baseline, recorded only (run \"make perf-baseline\" to record one)" % name)
+            continue
+        if base.get("events") is not None and base["events"] != result["events"]:
+            # Not a performance regression in itself, but timings of a changed model are not comparable
+            print("%-24s events %d, baseline %d: model behaviour changed, refresh the baseline if intended"
+                  % (name, result["events"], base["events"]))
+        for metric, direction in COMPARED_METRICS.items():
+            if not base.get(metric) or result.get(metric) is None:
+                continue
+            change = (result[metric] - base[metric]) / base[metric]
+            worse = -change * direction > tolerance
+            regressions += worse
+            print("%-24s %-20s %12g  baseline %12g  %+6.1f%%%s"
+                  % (name, metric, result[metric], base[metric], 100 * change, "  REGRESSION" if worse else ""))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulation performance regression check")
+    parser.add_argument("--sim", required=True, help="simulation executable (src/Insotu)")
+    parser.add_argument("--inet", required=True, help="INET project directory")
+    parser.add_argument("--output", default=os.path.join(PROJECT_DIR, "out", "perf_results.json"))
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--tolerance", type=float, help="allowed relative slowdown (default: from the baseline)")
+    parser.add_argument("--repeat", type=int, default=1, help="runs per configuration")
+    parser.add_argument("--update-baseline", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--only", action="append", choices=sorted(CANONICAL_RUNS), help="run only this configuration")
+    args = parser.parse_args()
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    tolerance = args.tolerance if args.tolerance is not None else baseline.get("tolerance", 0.15)
+
+    names = args.only or list(CANONICAL_RUNS)
+
+    sim = os.path.abspath(args.sim)
+    inet = os.path.abspath(args.inet)
+    results = {}
+    try:
+        for name in names:
+            print("running %s..." % name, flush=True)
+            results[name] = measure(sim, inet, name, max(1, args.repeat))
+    except (OSError, RuntimeError) as e:
+        print("perf_regression: %s" % e, file=sys.stderr)
+        return 2
+
+    report = {"host": platform.node(), "machine": platform.machine(), "tolerance": tolerance, "runs": results}
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+        f.write("\n")
+    print("results written to %s" % args.output)
+
+    if args.update_baseline:
+        runs = dict(baseline.get("runs", {}))
+        runs.update(results)
+        baseline.update({"host": report["host"], "machine": report["machine"], "tolerance": tolerance, "runs": runs})
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("baseline updated: %s" % args.baseline)
+        return 0
+
+    regressions = compare(results, baseline, tolerance)
+    if regressions:
+        print("%d metric(s) regressed by more than %.0f%%" % (regressions, 100 * tolerance))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())